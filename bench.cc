@@ -0,0 +1,101 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#include "edge_costs.hpp"
+#include "model.hpp"
+#include "search.hpp"
+
+// edge cost benchmark
+//
+// relaxes every edge of a generated map once with cellDistance() and once with the EdgeCosts
+// table, then times whole A* searches between random cells, which use the table
+
+static void usage(const char* name) {
+    std::cerr << "usage: " << name << " [-w width] [-h height] [-s seed] [-r rounds] [-q queries]\n"
+              << "-r passes over all edges per method, -q random A* queries afterwards" << std::endl;
+}
+
+template <class F>
+static double timed(F&& f) {
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char** argv) {
+    uint width = 1000;
+    uint height = 1000;
+    uint seed = 0;
+    uint rounds = 10;
+    uint queries = 100;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-w") && i + 1 < argc)
+            width = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-h") && i + 1 < argc)
+            height = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-q") && i + 1 < argc)
+            queries = atoi(argv[++i]);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Model model(width, height, seed);
+    const Terrain& terrain = model.getTerrain();
+    const EdgeCosts edges(terrain);
+
+    // the sums keep the loops from being optimized away and show both give the same lengths
+    double computedSum = 0, tableSum = 0;
+    uint64_t edgeCount = 0;
+
+    const double computed = timed([&] {
+        for (uint r = 0; r < rounds; ++r)
+            for (Cell c = 0; c < terrain.size(); ++c) {
+                float sum = 0;
+                forEachNeighborMove<8>(terrain, c, [&](Cell n, uint) {
+                    sum += cellDistance(terrain, c, n);
+                    ++edgeCount;
+                });
+                computedSum += sum;
+            }
+    });
+
+    const double table = timed([&] {
+        for (uint r = 0; r < rounds; ++r)
+            for (Cell c = 0; c < terrain.size(); ++c) {
+                float sum = 0;
+                forEachNeighborMove<8>(terrain, c, [&](Cell n, uint move) { sum += edges.length(move, c, n); });
+                tableSum += sum;
+            }
+    });
+
+    printf("%llu edges\n", (unsigned long long)edgeCount);
+    printf("computed    %.3fs  %.2f ns/edge  sum %.6g\n", computed, computed * 1e9 / edgeCount, computedSum);
+    printf("table       %.3fs  %.2f ns/edge  sum %.6g\n", table, table * 1e9 / edgeCount, tableSum);
+
+    Search search(terrain);
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<Cell> cell(0, Cell(terrain.size() - 1));
+    uint64_t expansions = 0;
+
+    const double searching = timed([&] {
+        for (uint q = 0; q < queries; ++q) {
+            search.run(cell(random), cell(random));
+            expansions += search.getExpansions();
+        }
+    });
+
+    printf("%u A* queries  %.3fs  %llu expansions  %.2f ns/expansion\n", queries, searching,
+           (unsigned long long)expansions, expansions ? searching * 1e9 / expansions : 0.);
+    return 0;
+}
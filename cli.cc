@@ -0,0 +1,286 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "model.hpp"
+#include "query_engine.hpp"
+#include "snapshot.hpp"
+#include "tiled_terrain.hpp"
+
+// headless batch pathfinder
+//
+// reads queries "startX startY endX endY" line by line from a file or stdin
+// and writes "startX startY endX endY length cost expansions" per query,
+// length is the number of steps on the path, cost its total distance
+// all queries are answered in parallel, output keeps the input order
+//
+// with -i the map is unbounded and generated in tiles while searching,
+// queries may use any 32-bit coordinates and run one after another
+
+static void usage(const char* name) {
+    std::cerr << "usage: " << name << " [-w width] [-h height] [-s seed] [-t threads] [-n map|sampled] [-m astar|jps|bidir|hpa [-x]] [-l landmarks] [-b microseconds] [-p dir] [-f map] [-o map] [-i [-c tiles]] [queries]\n"
+              << "reads queries from stdin if no file is given\n"
+              << "-n picks how noise is mapped to levels, map needs the whole map (default)\n"
+              << "-m jps uses jump point search, -m bidir bidirectional A*, both with the same costs as A*\n"
+              << "-m hpa uses hierarchical search, its paths may be longer\n"
+              << "-x also runs plain A* and appends its cost and expansions to every line\n"
+              << "-l precomputes distances to this many landmarks for a stronger heuristic\n"
+              << "-f loads a map saved with -o instead of generating one, -w -h -s and -n are ignored\n"
+              << "-o saves the map, loading it is much faster than generating it again\n"
+              << "-p renders the map and the search of the first query into png tiles under dir\n"
+              << "-b gives up on a query after this much time, its cost is printed as inf\n"
+              << "-i searches an unbounded tiled map keeping at most -c tiles in memory" << std::endl;
+}
+
+// batch on an unbounded map, see TiledTerrain
+static int runTiled(std::istream& in, uint seed, size_t maxTiles, const GeneratorSettings& settings) {
+    TiledTerrain terrain(seed, maxTiles, settings);
+    TiledSearch search(terrain);
+
+    uint64_t queries = 0;
+    uint64_t totalExpansions = 0;
+    auto begin = std::chrono::steady_clock::now();
+
+    int32_t sx, sy, ex, ey;
+    while (in >> sx >> sy >> ex >> ey) {
+        search.run({sx, sy}, {ex, ey});
+
+        size_t steps = search.getPath().size();
+        printf("%d %d %d %d %zu %.3f %llu\n", sx, sy, ex, ey, steps ? steps - 1 : 0, search.getCost(),
+               (unsigned long long)search.getExpansions());
+
+        ++queries;
+        totalExpansions += search.getExpansions();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    fprintf(stderr, "%llu queries, %llu expansions in %.3fs, %llu tiles generated, %zu resident\n",
+            (unsigned long long)queries, (unsigned long long)totalExpansions, seconds,
+            (unsigned long long)terrain.getGeneratedTiles(), terrain.getResidentTiles());
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    uint width = 4 * 50;
+    uint height = 3 * 50;
+    uint seed = 0;
+    uint threads = 0;        // one per hardware thread
+    bool tiled = false;      // unbounded map
+    SearchMode mode = SearchMode::AStar;
+    bool hierarchical = false;  // HPA*
+    bool compare = false;       // compare with plain A*
+    uint landmarks = 0;         // ALT heuristic if not 0
+    SearchBudget budget;        // per query, unlimited by default
+    size_t maxTiles = 4096;  // 64 MiB of tiles
+    GeneratorSettings settings;
+    const char* queryFile = nullptr;
+    const char* snapshotDir = nullptr;
+    const char* mapFile = nullptr;   // load instead of generating
+    const char* saveFile = nullptr;  // save the map
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-w") && i + 1 < argc)
+            width = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-h") && i + 1 < argc)
+            height = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+            landmarks = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            budget.time = std::chrono::microseconds(atoll(argv[++i]));
+        else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+            mapFile = argv[++i];
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            saveFile = argv[++i];
+        else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+            snapshotDir = argv[++i];
+        else if (!strcmp(argv[i], "-x"))
+            compare = true;
+        else if (!strcmp(argv[i], "-i"))
+            tiled = true;
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+            maxTiles = atoll(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "map")
+                settings.normalization = Normalization::MapBounds;
+            else if (mode == "sampled")
+                settings.normalization = Normalization::Sampled;
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "astar")
+                mode = SearchMode::AStar;
+            else if (name == "jps")
+                mode = SearchMode::JumpPoint;
+            else if (name == "bidir")
+                mode = SearchMode::Bidirectional;
+            else if (name == "hpa")
+                hierarchical = true;
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (argv[i][0] != '-' && !queryFile)
+            queryFile = argv[i];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (width < 2 || height < 2) {
+        std::cerr << "terrain must be at least 2x2" << std::endl;
+        return 1;
+    }
+
+    std::ifstream file;
+    if (queryFile) {
+        file.open(queryFile);
+        if (!file) {
+            std::cerr << "cannot open " << queryFile << std::endl;
+            return 1;
+        }
+    }
+    std::istream& in = queryFile ? file : std::cin;
+
+    if (tiled)
+        return runTiled(in, seed, maxTiles, settings);
+
+    std::unique_ptr<Model> map;
+    try {
+        auto begin = std::chrono::steady_clock::now();
+        map = mapFile ? std::make_unique<Model>(mapFile, threads) : std::make_unique<Model>(width, height, seed, settings, threads);
+        fprintf(stderr, "map %s in %.3fs\n", mapFile ? "loaded" : "generated",
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+
+        if (saveFile)
+            map->save(saveFile);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    Model& model = *map;
+    width = model.getWidth();
+    height = model.getHeight();
+    QueryEngine engine(model.getTerrain(), threads);
+    engine.setMode(mode);
+    engine.setBudget(budget);
+
+    std::vector<Query> queries;
+    uint sx, sy, ex, ey;
+    while (in >> sx >> sy >> ex >> ey) {
+        if (sx >= width || sy >= height || ex >= width || ey >= height) {
+            std::cerr << "query out of bounds: " << sx << ' ' << sy << ' ' << ex << ' ' << ey << std::endl;
+            continue;
+        }
+        queries.push_back({model.getCell(sx, sy), model.getCell(ex, ey)});
+    }
+
+    std::unique_ptr<Landmarks> tables;
+    if (landmarks) {
+        auto begin = std::chrono::steady_clock::now();
+        ThreadPool pool(threads);
+        tables = std::make_unique<Landmarks>(model.getTerrain(), landmarks);
+        tables->build(pool);
+        engine.setLandmarks(tables.get());
+        fprintf(stderr, "%u landmarks built in %.3fs\n", landmarks, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+    }
+
+    if (hierarchical) {
+        auto begin = std::chrono::steady_clock::now();
+        model.getHierarchy();
+        fprintf(stderr, "hierarchy built in %.3fs\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<QueryResult> results = hierarchical ? engine.run(queries, model.getHierarchy()) : engine.run(queries);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    // plain A* on the same queries
+    std::vector<QueryResult> exact;
+    if (compare) {
+        engine.setMode(SearchMode::AStar);
+        engine.setLandmarks(nullptr);
+        engine.setBudget({});
+        exact = engine.run(queries);
+    }
+
+    uint64_t totalExpansions = 0;
+    uint64_t exactExpansions = 0;
+    size_t incomplete = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const Query& q = queries[i];
+        const QueryResult& r = results[i];
+
+        printf("%u %u %u %u %u %.3f %llu", model.getX(q.start), model.getY(q.start), model.getX(q.end), model.getY(q.end),
+               r.length, r.cost, (unsigned long long)r.expansions);
+        if (compare) {
+            printf(" %.3f %llu", exact[i].cost, (unsigned long long)exact[i].expansions);
+            exactExpansions += exact[i].expansions;
+        }
+        printf("\n");
+
+        totalExpansions += r.expansions;
+        incomplete += !r.complete;
+    }
+
+    fprintf(stderr, "%zu queries, %llu expansions in %.3fs on %u threads\n", queries.size(),
+            (unsigned long long)totalExpansions, seconds, engine.getThreads());
+
+    if (incomplete)
+        fprintf(stderr, "%zu queries ran out of time\n", incomplete);
+
+    if (compare)
+        fprintf(stderr, "plain A*: %llu expansions\n", (unsigned long long)exactExpansions);
+
+    // relative extra cost of the hierarchical paths over exact ones
+    if (hierarchical && compare) {
+        double sum = 0, worst = 0;
+        size_t counted = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            if (exact[i].cost == INFINITY || exact[i].cost == 0) continue;
+            double extra = results[i].cost / exact[i].cost - 1.0;
+            sum += extra;
+            worst = std::max(worst, extra);
+            ++counted;
+        }
+        fprintf(stderr, "suboptimality vs A*: %.2f%% mean, %.2f%% max\n", counted ? 100.0 * sum / counted : 0.0, 100.0 * worst);
+    }
+
+    if (snapshotDir) {
+        auto begin = std::chrono::steady_clock::now();
+        if (!queries.empty()) {
+            model.setSearchMode(mode);
+            model.setStart(queries[0].start);
+            model.setEnd(queries[0].end);
+            model.findPath();
+        }
+
+        ThreadPool pool(threads);
+        Snapshot snapshot(model, pool);
+        if (!snapshot.write(snapshotDir)) {
+            std::cerr << "cannot write snapshot to " << snapshotDir << std::endl;
+            return 1;
+        }
+        fprintf(stderr, "snapshot with %u levels written in %.3fs\n", snapshot.getLevels(),
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+    }
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "budget.hpp"
+#include "model.hpp"
+
+// runs the searches of a Model on a worker thread
+//
+// The worker advances the search in short slices and holds the lock only during a slice.
+// Everyone else reads or changes the model only while holding lock(), so what they see
+// is always the state between two slices, never a half done expansion.
+// Setting a search up can build whole-map tables (landmarks, jump point runs), so the worker
+// does that as well. Until it is done isPreparing() is true and lock() would wait for it,
+// cancel() does not: it stops the build, which checks for that every few thousand cells.
+class AsyncSearch {
+public:
+    explicit AsyncSearch(Model& model) : model(model), worker([this] { workerLoop(); }) {}
+
+    ~AsyncSearch() {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+    AsyncSearch(const AsyncSearch&) = delete;
+    AsyncSearch& operator=(const AsyncSearch&) = delete;
+
+    // exclusive access to the model, waits for at most one slice
+    std::unique_lock<std::mutex> lock() {
+        ++waiting;
+        std::unique_lock<std::mutex> guard(mutex);
+        --waiting;
+        return guard;
+    }
+
+    // stops the running search, the returned lock keeps the worker out while the model changes
+    // a search that is still being set up drops its table builds, they start over next time
+    std::unique_lock<std::mutex> cancel() {
+        interrupt = true;
+        std::unique_lock<std::mutex> guard = lock();
+        interrupt = false;
+        running = false;
+        preparing = false;
+        return guard;
+    }
+
+    // starts a search from the model's start to its end, a running one is dropped
+    // returns right away, the worker sets the search up in its first slice
+    void start() {
+        {
+            std::unique_lock<std::mutex> guard = cancel();
+            preparing = true;
+            running = true;
+            finished = false;
+        }
+        wake.notify_all();
+    }
+
+    // true from start() until the worker has set the search up
+    // a viewer can show the last frame again instead of waiting in lock()
+    bool isPreparing() const { return preparing.load(); }
+
+    bool isRunning() {
+        if (preparing)
+            return true;
+        std::lock_guard<std::mutex> guard(mutex);
+        return running;
+    }
+
+    // true once after a search ran to its end, progress tells whether end was reached
+    bool takeResult(SearchProgress& progress) {
+        if (preparing)
+            return false;
+
+        std::lock_guard<std::mutex> guard(mutex);
+        if (!finished)
+            return false;
+
+        finished = false;
+        progress = result;
+        return true;
+    }
+
+private:
+    Model& model;
+
+    std::mutex mutex;  // guards the model and all fields below
+    std::condition_variable wake;
+    bool running = false;   // a search is set up and not done
+    bool finished = false;  // a search is done and its result not taken
+    bool stopping = false;  // the worker has to exit
+    SearchProgress result = SearchProgress::Running;
+
+    std::atomic<int> waiting{0};        // threads waiting in lock(), the worker steps aside for them
+    std::atomic<bool> preparing{false};  // the search is not set up yet, only changed under mutex
+    std::atomic<bool> interrupt{false};  // cancel() waits, a setup in progress stops
+
+    // work done per slice, short enough for other threads to get the lock every frame
+    static constexpr SearchBudget slice = {UINT64_MAX, std::chrono::microseconds(1000)};
+
+    std::thread worker;  // last member, starts when everything else is initialized
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> guard(mutex);
+        while (true) {
+            wake.wait(guard, [&] { return running || stopping; });
+            if (stopping)
+                return;
+
+            if (preparing) {
+                // a cancelled setup leaves nothing set up, cancel() takes over from here
+                if (!model.setupPathfinding(&interrupt))
+                    running = false;
+                preparing = false;
+            } else {
+                const SearchProgress progress = model.advancePathfinding(slice);
+                if (progress != SearchProgress::Running) {
+                    running = false;
+                    finished = true;
+                    result = progress;
+                }
+            }
+
+            // a mutex is not fair, without this the worker could take it again right away
+            guard.unlock();
+            while (waiting.load())
+                std::this_thread::yield();
+            guard.lock();
+        }
+    }
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// limit of a single resumable search call, whichever runs out first
+struct SearchBudget {
+    uint64_t expansions = UINT64_MAX;                                   // calls of iterate()
+    std::chrono::microseconds time = std::chrono::microseconds::max();  // wall clock time
+};
+
+// set by another thread to stop a long table build early, null if the build cannot be stopped
+typedef const std::atomic<bool>* CancelFlag;
+
+inline bool isCancelled(CancelFlag cancel) { return cancel && cancel->load(std::memory_order_relaxed); }
+
+enum class SearchProgress {
+    Running,      // budget used up, call again to continue
+    Found,        // the search is done and reached its end
+    Unreachable,  // the search is done, there is no path
+};
+
+// calls iterate() until it returns true or the budget is used up, true when done
+// the clock is only read every 64 iterations, a deadline may be overrun by that much work
+template <class F>
+bool iterateWithin(const SearchBudget& budget, F&& iterate) {
+    using Clock = std::chrono::steady_clock;
+    const bool timed = budget.time != std::chrono::microseconds::max();
+    const Clock::time_point deadline = timed ? Clock::now() + budget.time : Clock::time_point::max();
+
+    for (uint64_t i = 0; i < budget.expansions; ++i) {
+        if (iterate())
+            return true;
+        if (timed && (i & 63) == 63 && Clock::now() >= deadline)
+            return false;
+    }
+    return false;
+}
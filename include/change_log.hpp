@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "terrain.hpp"
+
+// cells whose drawn state changed since a viewer last looked
+//
+// Searches add a cell whenever it becomes visited or stops being visited, the viewer takes the
+// list and only recolors those cells. Changes that touch every cell at once, a new search or a
+// new terrain, mark the whole log instead. The log holds at most capacity cells, beyond that it
+// only remembers that everything changed, so a viewer that never looks costs no memory.
+class ChangeLog {
+public:
+    explicit ChangeLog(size_t capacity) : capacity(capacity) {}
+
+    void add(Cell c) {
+        if (all)
+            return;
+        if (cells.size() >= capacity) {
+            markAll();
+            return;
+        }
+        cells.push_back(c);
+    }
+
+    void markAll() {
+        all = true;
+        cells.clear();
+    }
+
+    // moves the changed cells to out and starts a new log
+    // false if everything changed, out is empty then
+    bool take(std::vector<Cell>& out) {
+        const bool listed = !all;
+        out.clear();
+        out.swap(cells);
+        all = false;
+        return listed;
+    }
+
+private:
+    const size_t capacity;
+    std::vector<Cell> cells;
+    bool all = true;  // nothing was taken yet
+};
@@ -1,14 +1,28 @@
 #include <SFML/Graphics.hpp>
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <utility>
 
+#include "async_search.hpp"
 #include "model.hpp"
 #include "window.hpp"
 
 class Controller {
 public:
-    Controller(Window& window, Model& model) : window(window), model(model) {}
+    Controller(Window& window, Model& model, AsyncSearch& pathfinder) : window(window), model(model), pathfinder(pathfinder) {}
+
+    // reports a search the worker finished, called once per frame
+    void update() {
+        SearchProgress progress;
+        if (!pathfinder.takeResult(progress))
+            return;
+
+        auto lock = pathfinder.lock();
+        if (progress == SearchProgress::Unreachable)
+            std::cout << "no path, ";
+        std::cout << model.getExpansions() << " cells expanded" << std::endl;
+    }
 
     void handleEvent(sf::Event& event) {
         switch (event.type) {
@@ -44,17 +58,50 @@ public:
     void handleKeyPressEvent(sf::Event& event) {
         switch (event.key.code) {
             case sf::Keyboard::Space:
-                if (model.getEnd() && model.getStart()) {
-                    model.setupPathfinding();
-                    while (!model.iteratePathfinding())
-                        ;
-                } else
+                if (model.getEnd() != noCell && model.getStart() != noCell)
+                    pathfinder.start();
+                else
                     std::cout << "Please select a start and end point first" << std::endl;
                 break;
 
-            case sf::Keyboard::R:
+            case sf::Keyboard::R: {
+                auto lock = pathfinder.cancel();
                 model.regenerateTerrain();
                 break;
+            }
+
+            case sf::Keyboard::M: {
+                auto lock = pathfinder.cancel();
+                switch (model.getSearchMode()) {
+                    case SearchMode::AStar:
+                        model.setSearchMode(SearchMode::JumpPoint);
+                        std::cout << "jump point search" << std::endl;
+                        break;
+                    case SearchMode::JumpPoint:
+                        model.setSearchMode(SearchMode::Bidirectional);
+                        std::cout << "bidirectional A*" << std::endl;
+                        break;
+                    default:
+                        model.setSearchMode(SearchMode::AStar);
+                        std::cout << "A*" << std::endl;
+                        break;
+                }
+                break;
+            }
+
+            case sf::Keyboard::L: {
+                auto lock = pathfinder.cancel();
+                model.setUseLandmarks(!model.getUseLandmarks());
+                std::cout << (model.getUseLandmarks() ? "landmark heuristic on" : "landmark heuristic off") << std::endl;
+                break;
+            }
+
+            case sf::Keyboard::I: {
+                auto lock = pathfinder.cancel();
+                model.setIncremental(!model.getIncremental());
+                std::cout << (model.getIncremental() ? "incremental planning on" : "incremental planning off") << std::endl;
+                break;
+            }
 
             case sf::Keyboard::Q:
                 window.close();
@@ -74,6 +121,9 @@ public:
         if (event.mouseButton.button == sf::Mouse::Right) {
             rightIsPressed = true;
         }
+
+        if (event.mouseButton.button == sf::Mouse::Middle)
+            mouseMiddleClick(event);
     }
 
     void handleMouseReleaseEvent(sf::Event& event) {
@@ -96,7 +146,8 @@ public:
         if (x < 0 || x > model.getWidth() - 1 || y < 0 || y > model.getHeight() - 1)
             return;
 
-        model.setStart(model.getPoint(x, y));
+        auto lock = pathfinder.cancel();
+        model.setStart(model.getCell(x, y));
     }
 
     void mouseRightClick(sf::Event& event) {
@@ -107,7 +158,32 @@ public:
         if (x < 0 || x > model.getWidth() - 1 || y < 0 || y > model.getHeight() - 1)
             return;
 
-        model.setEnd(model.getPoint(x, y));
+        auto lock = pathfinder.cancel();
+        model.setEnd(model.getCell(x, y));
+    }
+
+    // raises a wall under the cursor, replans right away in incremental mode
+    void mouseMiddleClick(sf::Event& event) {
+        auto pos = window.mapPixelToCoords(sf::Vector2i(event.mouseButton.x, event.mouseButton.y));
+        int x = int(pos.x) / window.getPixelSize();
+        int y = int(pos.y) / window.getPixelSize();
+
+        if (x < 0 || x > model.getWidth() - 1 || y < 0 || y > model.getHeight() - 1)
+            return;
+
+        std::vector<HeightEdit> edits;
+        for (int ey = std::max(0, y - 2); ey <= std::min(int(model.getHeight()) - 1, y + 2); ++ey)
+            for (int ex = std::max(0, x - 2); ex <= std::min(int(model.getWidth()) - 1, x + 2); ++ex)
+                edits.push_back({uint(ex), uint(ey), 1.f});
+        bool replan;
+        {
+            auto lock = pathfinder.cancel();
+            model.applyHeightEdits(edits);
+            replan = model.getIncremental() && model.getEnd() != noCell && model.getStart() != noCell;
+        }
+
+        if (replan)
+            pathfinder.start();
     }
 
     void handleMouseMoveEvent(sf::Event& event) {
@@ -138,6 +214,7 @@ public:
 private:
     Window& window;
     Model& model;
+    AsyncSearch& pathfinder;
 
     bool leftIsPressed = false;
     bool leftWasMoved = false;
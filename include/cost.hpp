@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "terrain.hpp"
+
+// multiplier for heigth cost in 3d euclidean distance calculation
+constexpr float heightCostMult = 200.f;
+
+// euclidean distance where height is the 3rd dimension
+inline float distance3D(float dx, float dy, float dz) {
+    dz *= heightCostMult;
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+// distance3D() between two cells of terrain
+inline float cellDistance(const Terrain& terrain, Cell p1, Cell p2) {
+    const float dx = float(terrain.xOf(p1)) - float(terrain.xOf(p2));
+    const float dy = float(terrain.yOf(p1)) - float(terrain.yOf(p2));
+    return distance3D(dx, dy, terrain.getElevation(p1) - terrain.getElevation(p2));
+}
+
+// moves a search on to its next generation, cells stamped with an older one count as untouched
+// only wraps after ~2^32 / step searches, then all stamps are reset once and it starts at step
+template <class... Stamps>
+inline void nextGeneration(uint32_t& generation, uint32_t step, Stamps&... stamps) {
+    generation += step;
+    if (generation == 0) {
+        (std::fill(stamps.begin(), stamps.end(), 0), ...);
+        generation = step;
+    }
+}
+
+// Cost is the type Search accumulates distances and compares keys in.
+// Build with -DPATH_FIXED_COST for fixed-point costs: sums are exact, the same
+// on every platform, and comparing keys is a single integer compare.
+#ifdef PATH_FIXED_COST
+typedef int32_t Cost;  // 1/256 units, paths up to ~8 million long
+constexpr Cost infiniteCost = INT32_MAX;
+constexpr float costScale = 256.f;
+
+// edge costs round up and lower bounds round down, so a consistent heuristic stays consistent
+// both are never negative, so truncation is floor and needs no libm call
+inline Cost edgeCost(float d) {
+    const float scaled = d * costScale;
+    const Cost c = Cost(scaled);
+    return c + (float(c) < scaled);
+}
+inline Cost boundCost(float d) { return Cost(d * costScale); }
+inline float costToFloat(Cost c) { return c == infiniteCost ? INFINITY : float(c) / costScale; }
+
+// rounds down, also for negative costs
+inline Cost halveCost(Cost c) { return c >> 1; }
+
+// fixed-point sums are exact, so equal costs compare equal
+inline Cost roundingSlack(Cost) { return 0; }
+#else
+typedef float Cost;
+constexpr Cost infiniteCost = INFINITY;
+
+inline Cost edgeCost(float d) { return d; }
+inline Cost boundCost(float d) { return d; }
+inline float costToFloat(Cost c) { return c; }
+inline Cost halveCost(Cost c) { return 0.5f * c; }
+
+// float sums of the same length along different paths may differ in the last bits
+// a sum of n positive terms is off by at most (n - 1) * epsilon / 2 of its value, this covers
+// paths of up to 4096 edges; longer ones may miss a tie by a few ulps, which only costs exactness
+// in the last bits of the result
+constexpr Cost costRelativeError = 4096 * std::numeric_limits<Cost>::epsilon() / 2;
+inline Cost roundingSlack(Cost c) { return c * costRelativeError; }
+#endif
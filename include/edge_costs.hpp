@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "cost.hpp"
+#include "neighborhood.hpp"
+#include "terrain.hpp"
+
+// length of every move between neighbors, looked up instead of computed
+//
+// A move has one of moveClasses planar lengths and the heights of its cells differ by a whole
+// number of levels, so there are only moveClasses * levels different edges. Their lengths are
+// computed once with distance3D(), relaxing an edge is then two byte loads and a table read
+// instead of a sqrtf. Distances between cells that are no neighbors still need distance3D().
+class EdgeCosts {
+public:
+    explicit EdgeCosts(const Terrain& terrain) : terrain(terrain), levels(terrain.getLevels()) {
+        static constexpr float planar[moveClasses][2] = {{1.f, 0.f}, {1.f, 1.f}, {2.f, 1.f}};
+
+        lengths.resize(moveClasses * levels);
+        costs.resize(moveClasses * levels);
+        for (uint move = 0; move < moveClasses; ++move)
+            for (uint delta = 0; delta < levels; ++delta) {
+                const float d = distance3D(planar[move][0], planar[move][1], levelHeight(delta, levels));
+                lengths[move * levels + delta] = d;
+                costs[move * levels + delta] = edgeCost(d);
+            }
+    }
+
+    // of the move from a to its neighbor b, move is the moveClass() of the offset
+    float length(uint move, Cell a, Cell b) const { return lengths[index(move, a, b)]; }
+    Cost cost(uint move, Cell a, Cell b) const { return costs[index(move, a, b)]; }
+
+    // of a move that stays on one level
+    Cost flatCost(uint move) const { return costs[move * levels]; }
+
+private:
+    const Terrain& terrain;
+    const uint levels;
+
+    std::vector<float> lengths;  // by move class, then level difference
+    std::vector<Cost> costs;     // edgeCost() of lengths
+
+    // indices past the last level have its height, as in Terrain
+    uint level(Cell c) const { return std::min<uint>(terrain.getLevel(c), levels - 1); }
+
+    uint index(uint move, Cell a, Cell b) const {
+        const int delta = int(level(a)) - int(level(b));
+        return move * levels + uint(delta < 0 ? -delta : delta);
+    }
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "perlin_noise.hpp"
+#include "terrain.hpp"
+
+typedef unsigned int uint;
+
+// how raw noise is rescaled to [0, 1] before it is clustered into levels
+enum class Normalization {
+    MapBounds,  // min and max of the generated map, needs the whole map first
+    Sampled,    // min and max of a fixed sample grid spread over one noise period
+};
+
+// parameters of the perlin terrain
+struct GeneratorSettings {
+    uint octaves = 20;         // how many octaves
+    double stepSize = 0.03;    // multiplier for x and y values, to reduce step size
+    double persistence = 0.4;  // how much the value of the next octave is reduced
+    uint levels = 14;          // number of distinct heights, at most 256
+    Normalization normalization = Normalization::MapBounds;
+};
+
+// range of the raw noise that is mapped to [0, 1]
+// the default is the whole range of octave2D_01(); a bound from the octave amplitudes does not
+// get tighter than that, the sum of even a single octave can leave [-1, 1] and is clamped there
+struct NoiseBounds {
+    double lower = 0.0;
+    double upper = 1.0;
+};
+
+// clusters a height in [0, 1] into one of the levels, result is the level index
+// values outside of [0, 1] end up in the lowest or highest level
+inline uint8_t quantizeLevel(float value, uint levels) {
+    int step = int(value * levels);              // step is (int[0, levels])
+    if (step >= int(levels)) step = levels - 1;  // int[0, levels-1]
+    if (step < 0) step = 0;
+    return uint8_t(step);
+}
+
+// height of the level a value in [0, 1] is clustered into, result is in [0, 1]
+inline float quantizeHeight(float value, uint levels) {
+    return levelHeight(quantizeLevel(value, levels), levels);
+}
+
+// the octave sum repeats every 256 / stepSize cells in both directions,
+// so a grid spread over one period sees every part of any map
+// the result only depends on the seed and the settings, never on the map
+inline NoiseBounds sampledBounds(const siv::PerlinNoise& perlin, const GeneratorSettings& settings, uint samples = 256) {
+    const double period = 256.0 / settings.stepSize;
+    const double stride = std::max(1.0, std::floor(period / samples));  // in cells
+
+    NoiseBounds bounds{2.0, -1.0};
+    std::vector<double> noise(samples);
+
+    for (uint j = 0; j < samples; ++j) {
+        perlin.octave2DRow_01(0.0, stride * settings.stepSize, j * stride * settings.stepSize, settings.octaves,
+                              settings.persistence, noise.data(), samples);
+
+        for (double n : noise) {
+            bounds.lower = std::min(bounds.lower, n);
+            bounds.upper = std::max(bounds.upper, n);
+        }
+    }
+
+    return bounds;
+}
+
+// bounds that do not depend on the map, MapBounds falls back to Sampled
+inline NoiseBounds independentBounds(const siv::PerlinNoise& perlin, const GeneratorSettings& settings) {
+    return sampledBounds(perlin, settings);
+}
+
+// noise, normalization and quantization of count cells starting at (x, y) in one go
+// out gets the level index of every cell, noise is a scratch buffer of at least count values
+inline void generateRow(const siv::PerlinNoise& perlin, const GeneratorSettings& settings, const NoiseBounds& bounds,
+                        double x, double y, uint8_t* out, size_t count, double* noise) {
+    perlin.octave2DRow_01(x, settings.stepSize, y * settings.stepSize, settings.octaves, settings.persistence, noise, count);
+
+    for (size_t i = 0; i < count; ++i) {
+        float value = (noise[i] - bounds.lower) / (bounds.upper - bounds.lower);
+        out[i] = quantizeLevel(value, settings.levels);
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "terrain.hpp"
+
+// min, max and mean height of square blocks of the terrain, for drawing it at lower detail
+//
+// Level k has one entry per 2^k x 2^k block of cells, ceil(width / 2^k) x ceil(height / 2^k)
+// entries, up to a last level with a single entry. Level 0 is the terrain itself and is not
+// copied. Blocks on the right and bottom border may hold fewer cells, their mean only counts
+// the cells they have.
+class HeightPyramid {
+public:
+    explicit HeightPyramid(const Terrain& terrain) : terrain(terrain) {}
+
+    // has to be called again whenever the terrain changed
+    void build() {
+        levels.clear();
+
+        uint w = terrain.getWidth(), h = terrain.getHeight();
+        for (uint level = 1; w > 1 || h > 1; ++level) {
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+
+            Level next;
+            next.width = w;
+            next.height = h;
+            next.min.resize(size_t(w) * h);
+            next.max.resize(size_t(w) * h);
+            next.mean.resize(size_t(w) * h);
+
+            for (uint y = 0; y < h; ++y)
+                for (uint x = 0; x < w; ++x)
+                    reduce(level, x, y, next);
+
+            levels.push_back(std::move(next));
+        }
+    }
+
+    // repairs the blocks that hold one of cells after their heights changed
+    // only the ancestors of the cells are reduced again, build() has to have been called before
+    void update(const std::vector<Cell>& cells) {
+        blocks.clear();
+        for (Cell c : cells)
+            blocks.push_back({terrain.xOf(c), terrain.yOf(c)});
+
+        for (uint level = 1; level < getLevels(); ++level) {
+            for (auto& b : blocks)
+                b = {b.first / 2, b.second / 2};
+            std::sort(blocks.begin(), blocks.end());
+            blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+
+            for (const auto& b : blocks)
+                reduce(level, b.first, b.second, levels[level - 1]);
+        }
+    }
+
+    // number of levels including level 0
+    uint getLevels() const { return uint(levels.size()) + 1; }
+
+    uint getWidth(uint level) const { return level ? levels[level - 1].width : terrain.getWidth(); }
+    uint getHeight(uint level) const { return level ? levels[level - 1].height : terrain.getHeight(); }
+
+    // of the block (x, y) on level
+    float getMin(uint level, uint x, uint y) const { return level ? at(levels[level - 1].min, level, x, y) : height(x, y); }
+    float getMax(uint level, uint x, uint y) const { return level ? at(levels[level - 1].max, level, x, y) : height(x, y); }
+    float getMean(uint level, uint x, uint y) const { return level ? at(levels[level - 1].mean, level, x, y) : height(x, y); }
+
+private:
+    struct Level {
+        uint width = 0, height = 0;
+        std::vector<float> min, max, mean;
+    };
+
+    const Terrain& terrain;
+    std::vector<Level> levels;  // level k is at k - 1
+
+    std::vector<std::pair<uint, uint>> blocks;  // blocks update() reduces on the current level
+
+    float height(uint x, uint y) const { return terrain.getElevation(terrain.cellAt(x, y)); }
+
+    float at(const std::vector<float>& values, uint level, uint x, uint y) const {
+        return values[size_t(y) * levels[level - 1].width + x];
+    }
+
+    // number of cells in the block (x, y) on level
+    uint cellCount(uint level, uint x, uint y) const {
+        const uint side = 1u << level;
+        return std::min(side, terrain.getWidth() - x * side) * std::min(side, terrain.getHeight() - y * side);
+    }
+
+    // block (x, y) of level from the up to 2x2 blocks below it
+    void reduce(uint level, uint x, uint y, Level& out) const {
+        const uint below = level - 1;
+        float lo = INFINITY, hi = -INFINITY;
+        double sum = 0;
+        uint count = 0;
+
+        for (uint cy = 2 * y; cy < std::min(2 * y + 2, getHeight(below)); ++cy)
+            for (uint cx = 2 * x; cx < std::min(2 * x + 2, getWidth(below)); ++cx) {
+                const uint n = cellCount(below, cx, cy);
+                lo = std::min(lo, getMin(below, cx, cy));
+                hi = std::max(hi, getMax(below, cx, cy));
+                sum += double(getMean(below, cx, cy)) * n;
+                count += n;
+            }
+
+        const size_t i = size_t(y) * out.width + x;
+        out.min[i] = lo;
+        out.max[i] = hi;
+        out.mean[i] = float(sum / count);
+    }
+};
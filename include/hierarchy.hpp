@@ -0,0 +1,476 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "cost.hpp"
+#include "edge_costs.hpp"
+#include "neighborhood.hpp"
+#include "open_list.hpp"
+#include "terrain.hpp"
+#include "thread_pool.hpp"
+
+// cells of one cluster, [x0, x1) x [y0, y1)
+struct ClusterRect {
+    uint x0, y0, x1, y1;
+
+    bool contains(uint x, uint y) const { return x >= x0 && x < x1 && y >= y0 && y < y1; }
+    uint width() const { return x1 - x0; }
+};
+
+// search that never leaves one cluster
+// used to precompute costs between the entrances of a cluster and to refine abstract paths
+class ClusterSearch {
+public:
+    explicit ClusterSearch(uint clusterSize) {
+        const size_t n = size_t(clusterSize) * clusterSize;
+        distances.assign(n, INFINITY);
+        prevs.assign(n, noCell);
+        stamps.assign(n, 0);
+        heap.resize(uint32_t(n));
+    }
+
+    // distances from `from` to the cells of r, stops once `to` is done if it is given
+    void run(const Terrain& terrain, const ClusterRect& r, Cell from, Cell to = noCell) {
+        nextGeneration(generation, 2, stamps);
+        heap.clear();
+
+        if (terrain_ != &terrain || !edges)
+            edges.emplace(terrain);
+        terrain_ = &terrain;
+        rect = r;
+        goal = to;
+
+        const uint32_t s = local(from);
+        stamps[s] = generation;
+        distances[s] = 0;
+        prevs[s] = noCell;
+        heap.push(s, heuristic(from));
+
+        while (!heap.empty()) {
+            const uint32_t a = heap.top();
+            const Cell active = cellOf(a);
+            if (active == goal)
+                return;
+            heap.pop();
+
+            forEachNeighborMove<8>(terrain, active, [&](Cell p, uint move) {
+                const uint px = terrain.xOf(p), py = terrain.yOf(p);
+                if (!rect.contains(px, py)) return;
+
+                const uint32_t l = local(p);
+                if (stamps[l] == generation + 1) return;  // skip visited cells
+
+                const float dist = distances[a] + edges->length(move, active, p);
+                if (stamps[l] != generation || dist < distances[l]) {
+                    stamps[l] = generation;
+                    distances[l] = dist;
+                    prevs[l] = active;
+                    heap.push(l, dist + heuristic(p));
+                }
+            });
+
+            stamps[a] = generation + 1;
+        }
+    }
+
+    // distance of a cell of the cluster from the last run
+    float getDistance(Cell c) const {
+        const uint32_t l = local(c);
+        return stamps[l] >= generation ? distances[l] : INFINITY;
+    }
+
+    // appends the cells from c back to the start of the last run, c excluded and the start included
+    void appendPath(Cell c, std::vector<Cell>& path) const {
+        for (Cell p = prevs[local(c)]; p != noCell; p = prevs[local(p)])
+            path.push_back(p);
+    }
+
+private:
+    std::vector<float> distances;  // indexed by local cell
+    std::vector<Cell> prevs;
+    std::vector<uint32_t> stamps;
+    uint32_t generation = 2;
+    OpenList heap;
+
+    const Terrain* terrain_ = nullptr;
+    std::optional<EdgeCosts> edges;  // of terrain_
+    ClusterRect rect{};
+    Cell goal = noCell;
+
+    uint32_t local(Cell c) const { return (terrain_->yOf(c) - rect.y0) * rect.width() + terrain_->xOf(c) - rect.x0; }
+    Cell cellOf(uint32_t l) const { return terrain_->cellAt(rect.x0 + l % rect.width(), rect.y0 + l / rect.width()); }
+
+    // zero without a goal, so the run is plain Dijkstra
+    float heuristic(Cell p) const { return goal == noCell ? 0.f : cellDistance(*terrain_, p, goal); }
+};
+
+// HPA* abstraction of a terrain
+//
+// The terrain is cut into square clusters. Every border between two clusters is split into
+// segments of `spacing` cells, each segment gets one entrance: the pair of facing cells with
+// the smallest height difference. Both cells become abstract nodes, joined by an inter edge.
+// Nodes of the same cluster are joined by intra edges whose costs are shortest paths that stay
+// inside the cluster. Paths on this graph are never shorter than exact A* paths; the gap comes
+// from fixed entrances and paths that are bound to clusters.
+//
+// Node ids are fixed: a cluster owns 4 sides of `perSide` slots each and a slot is the entrance
+// of one segment, so a cluster can be rebuilt without renumbering its neighbors.
+class Hierarchy {
+public:
+    static constexpr uint sides = 4;  // -x, +x, -y, +y, the opposite side is side ^ 1
+
+    explicit Hierarchy(const Terrain& terrain, uint clusterSize = 32, uint spacing = 8)
+        : terrain(terrain),
+          clusterSize(clusterSize),
+          spacing(std::min(spacing, clusterSize)),
+          perSide((clusterSize + this->spacing - 1) / this->spacing),
+          clustersX((terrain.getWidth() + clusterSize - 1) / clusterSize),
+          clustersY((terrain.getHeight() + clusterSize - 1) / clusterSize) {
+        const size_t n = size_t(clustersX) * clustersY;
+        cells.assign(n * nodesPerCluster(), noCell);
+        costs.assign(n * nodesPerCluster() * nodesPerCluster(), INFINITY);
+        dirty.assign(n, 0);
+        invalidate();
+    }
+
+    // marks every cluster for rebuild
+    void invalidate() {
+        dirtyClusters.clear();
+        for (uint c = 0; c < clusterCount(); ++c) {
+            dirty[c] = 1;
+            dirtyClusters.push_back(c);
+        }
+    }
+
+    // marks the cluster of a changed cell for rebuild
+    void markChanged(uint x, uint y) {
+        const uint c = clusterAt(x, y);
+        if (!dirty[c]) {
+            dirty[c] = 1;
+            dirtyClusters.push_back(c);
+        }
+    }
+
+    bool isDirty() const { return !dirtyClusters.empty(); }
+
+    // recomputes entrances and intra edges of the changed clusters
+    // and the intra edges of their neighbors, which share the changed borders
+    void rebuild(ThreadPool& pool) {
+        if (dirtyClusters.empty()) return;
+
+        std::vector<uint8_t> affected(clusterCount(), 0);
+        for (uint c : dirtyClusters)
+            for (uint side = 0; side < sides; ++side) {
+                affected[c] = 1;
+                const uint n = neighbor(c, side);
+                if (n == noCluster) continue;
+                affected[n] = 1;
+                placeEntrances(c, side);
+            }
+
+        std::vector<uint> clusters;
+        for (uint c = 0; c < clusterCount(); ++c) {
+            if (affected[c]) clusters.push_back(c);
+            dirty[c] = 0;
+        }
+        dirtyClusters.clear();
+
+        std::vector<ClusterSearch> searches(pool.size(), ClusterSearch(clusterSize));
+        pool.run(clusters.size(), [&](uint worker, size_t i) { connectCluster(clusters[i], searches[worker]); });
+    }
+
+    const Terrain& getTerrain() const { return terrain; }
+    uint getClusterSize() const { return clusterSize; }
+    uint clusterCount() const { return clustersX * clustersY; }
+    uint nodesPerCluster() const { return sides * perSide; }
+    uint nodeCount() const { return clusterCount() * nodesPerCluster(); }
+
+    uint clusterAt(uint x, uint y) const { return (y / clusterSize) * clustersX + x / clusterSize; }
+    uint clusterOf(Cell c) const { return clusterAt(terrain.xOf(c), terrain.yOf(c)); }
+    uint clusterOfNode(uint node) const { return node / nodesPerCluster(); }
+
+    ClusterRect rectOf(uint cluster) const {
+        const uint x0 = (cluster % clustersX) * clusterSize;
+        const uint y0 = (cluster / clustersX) * clusterSize;
+        return {x0, y0, std::min(x0 + clusterSize, terrain.getWidth()), std::min(y0 + clusterSize, terrain.getHeight())};
+    }
+
+    // cell of an abstract node, noCell if the slot is unused
+    Cell nodeCell(uint node) const { return cells[node]; }
+
+    // node on the other side of the entrance
+    uint partner(uint node) const {
+        const uint local = node % nodesPerCluster();
+        const uint side = local / perSide;
+        return neighbor(clusterOfNode(node), side) * nodesPerCluster() + (side ^ 1) * perSide + local % perSide;
+    }
+
+    // cost between two nodes of the same cluster given by their local slots
+    float intraCost(uint cluster, uint from, uint to) const {
+        return costs[(size_t(cluster) * nodesPerCluster() + from) * nodesPerCluster() + to];
+    }
+
+private:
+    static constexpr uint noCluster = UINT32_MAX;
+
+    const Terrain& terrain;
+    const uint clusterSize;
+    const uint spacing;  // border cells per entrance
+    const uint perSide;  // entrance slots per cluster side
+    const uint clustersX, clustersY;
+
+    std::vector<Cell> cells;           // cell of every node slot
+    std::vector<float> costs;          // intra edge costs, one matrix per cluster
+    std::vector<uint8_t> dirty;        // 1 if the cluster waits for rebuild
+    std::vector<uint> dirtyClusters;  // clusters waiting for rebuild
+
+    uint neighbor(uint c, uint side) const {
+        const uint cx = c % clustersX, cy = c / clustersX;
+        switch (side) {
+            case 0: return cx > 0 ? c - 1 : noCluster;
+            case 1: return cx + 1 < clustersX ? c + 1 : noCluster;
+            case 2: return cy > 0 ? c - clustersX : noCluster;
+            default: return cy + 1 < clustersY ? c + clustersX : noCluster;
+        }
+    }
+
+    // picks the entrance cells on one side of c and the facing side of its neighbor
+    void placeEntrances(uint c, uint side) {
+        const ClusterRect r = rectOf(c);
+        const bool vertical = side < 2;  // border runs along y
+        const uint length = vertical ? r.y1 - r.y0 : r.x1 - r.x0;
+
+        const uint n = neighbor(c, side);
+        const uint base = c * nodesPerCluster() + side * perSide;
+        const uint otherBase = n * nodesPerCluster() + (side ^ 1) * perSide;
+
+        for (uint s = 0; s < perSide; ++s) {
+            cells[base + s] = cells[otherBase + s] = noCell;
+
+            const uint begin = s * spacing;
+            const uint end = std::min(begin + spacing, length);
+            if (begin >= end) continue;
+
+            // facing pair with the smallest height difference, ties go to the middle
+            float best = INFINITY;
+            uint bestDistance = UINT32_MAX;
+            for (uint i = begin; i < end; ++i) {
+                uint x, y, ox, oy;
+                if (vertical) {
+                    y = oy = r.y0 + i;
+                    x = side == 0 ? r.x0 : r.x1 - 1;
+                    ox = side == 0 ? x - 1 : x + 1;
+                } else {
+                    x = ox = r.x0 + i;
+                    y = side == 2 ? r.y0 : r.y1 - 1;
+                    oy = side == 2 ? y - 1 : y + 1;
+                }
+
+                const Cell a = terrain.cellAt(x, y), b = terrain.cellAt(ox, oy);
+                const float diff = std::abs(terrain.getElevation(a) - terrain.getElevation(b));
+                const uint toMiddle = std::abs(int(2 * i) - int(begin + end - 1));
+
+                if (diff < best || (diff == best && toMiddle < bestDistance)) {
+                    best = diff;
+                    bestDistance = toMiddle;
+                    cells[base + s] = a;
+                    cells[otherBase + s] = b;
+                }
+            }
+        }
+    }
+
+    // shortest paths inside c between all of its nodes
+    void connectCluster(uint c, ClusterSearch& search) {
+        const uint n = nodesPerCluster();
+        const ClusterRect r = rectOf(c);
+        const Cell* nodes = &cells[size_t(c) * n];
+        float* matrix = &costs[size_t(c) * n * n];
+
+        for (uint i = 0; i < n; ++i) {
+            if (nodes[i] == noCell) {
+                std::fill(matrix + i * n, matrix + (i + 1) * n, INFINITY);
+                continue;
+            }
+
+            search.run(terrain, r, nodes[i]);
+            for (uint j = 0; j < n; ++j)
+                matrix[i * n + j] = nodes[j] == noCell ? INFINITY : search.getDistance(nodes[j]);
+        }
+    }
+};
+
+// state of a single query on a Hierarchy
+// like Search, every thread needs its own, the hierarchy is only read
+class HierarchicalSearch {
+public:
+    explicit HierarchicalSearch(const Hierarchy& hierarchy)
+        : hierarchy(hierarchy),
+          terrain(hierarchy.getTerrain()),
+          startNode(hierarchy.nodeCount()),
+          endNode(hierarchy.nodeCount() + 1),
+          cluster(hierarchy.getClusterSize()) {
+        distances.assign(hierarchy.nodeCount() + 2, INFINITY);
+        prevs.assign(hierarchy.nodeCount() + 2, noNode);
+        stamps.assign(hierarchy.nodeCount() + 2, 0);
+        heap.resize(hierarchy.nodeCount() + 2);
+        startCosts.resize(hierarchy.nodesPerCluster());
+        endCosts.resize(hierarchy.nodesPerCluster());
+    }
+
+    // searches the abstract graph, false if to is unreachable
+    // the cell path is only refined when getPath() asks for it
+    bool run(Cell from, Cell to) {
+        clear();
+        start = from;
+        end = to;
+        startCluster = hierarchy.clusterOf(from);
+        endCluster = hierarchy.clusterOf(to);
+
+        // temporary edges from start and to end into their clusters
+        const uint n = hierarchy.nodesPerCluster();
+        cluster.run(terrain, hierarchy.rectOf(startCluster), from);
+        for (uint i = 0; i < n; ++i)
+            startCosts[i] = nodeCost(startCluster * n + i);
+        direct = startCluster == endCluster ? cluster.getDistance(to) : INFINITY;
+
+        cluster.run(terrain, hierarchy.rectOf(endCluster), to);
+        for (uint i = 0; i < n; ++i)
+            endCosts[i] = nodeCost(endCluster * n + i);
+
+        stamps[startNode] = generation;
+        distances[startNode] = 0;
+        prevs[startNode] = noNode;
+        heap.push(startNode, heuristic(from));
+
+        while (!heap.empty()) {
+            const uint32_t active = heap.top();
+            if (active == endNode)
+                return true;
+
+            heap.pop();
+            ++expansions;
+            expand(active);
+            stamps[active] = generation + 1;
+        }
+
+        return false;
+    }
+
+    float getCost() const { return stamps[endNode] >= generation ? distances[endNode] : INFINITY; }
+
+    // number of abstract nodes expanded by the last run
+    uint64_t getExpansions() const { return expansions; }
+
+    // cells from end back to start, empty if there is no path
+    // only the abstract edges on the path are refined into cells
+    const std::vector<Cell>& getPath() {
+        if (path.empty() && getCost() != INFINITY) {
+            path.push_back(end);
+            for (uint32_t v = endNode; v != startNode; v = prevs[v])
+                refine(prevs[v], v);
+        }
+        return path;
+    }
+
+private:
+    static constexpr uint32_t noNode = UINT32_MAX;
+
+    const Hierarchy& hierarchy;
+    const Terrain& terrain;
+    const uint32_t startNode, endNode;  // temporary nodes behind the regular ones
+
+    std::vector<float> distances;  // indexed by node
+    std::vector<uint32_t> prevs;
+    std::vector<uint32_t> stamps;
+    uint32_t generation = 2;
+    OpenList heap;
+    uint64_t expansions = 0;
+
+    Cell start = noCell, end = noCell;
+    uint startCluster = 0, endCluster = 0;
+    std::vector<float> startCosts;  // from start to the nodes of its cluster
+    std::vector<float> endCosts;    // from the nodes of the end cluster to end
+    float direct = INFINITY;        // start to end inside their common cluster
+
+    ClusterSearch cluster;
+    std::vector<Cell> path;
+
+    void clear() {
+        nextGeneration(generation, 2, stamps);
+        heap.clear();
+        expansions = 0;
+        path.clear();
+    }
+
+    Cell cellOf(uint32_t node) const {
+        return node == startNode ? start : node == endNode ? end : hierarchy.nodeCell(node);
+    }
+
+    float nodeCost(uint node) const {
+        const Cell c = hierarchy.nodeCell(node);
+        return c == noCell ? INFINITY : cluster.getDistance(c);
+    }
+
+    void expand(uint32_t active) {
+        const uint n = hierarchy.nodesPerCluster();
+        const float d = distances[active];
+
+        if (active == startNode) {
+            for (uint i = 0; i < n; ++i)
+                relax(active, startCluster * n + i, d + startCosts[i]);
+            relax(active, endNode, d + direct);
+            return;
+        }
+
+        const uint c = hierarchy.clusterOfNode(active);
+        const uint local = active % n;
+
+        // inter edge, entrance cells are neighbors
+        const uint other = hierarchy.partner(active);
+        relax(active, other, d + cellDistance(terrain, hierarchy.nodeCell(active), hierarchy.nodeCell(other)));
+
+        // intra edges
+        for (uint i = 0; i < n; ++i)
+            if (i != local)
+                relax(active, c * n + i, d + hierarchy.intraCost(c, local, i));
+
+        if (c == endCluster)
+            relax(active, endNode, d + endCosts[local]);
+    }
+
+    void relax(uint32_t active, uint32_t p, float dist) {
+        if (dist == INFINITY || stamps[p] == generation + 1) return;
+
+        if (stamps[p] != generation || dist < distances[p]) {
+            stamps[p] = generation;
+            distances[p] = dist;
+            prevs[p] = active;
+            heap.push(p, dist + heuristic(cellOf(p)));
+        }
+    }
+
+    // appends the cells of the abstract edge from u to v, v itself is already on the path
+    void refine(uint32_t u, uint32_t v) {
+        const Cell from = cellOf(u), to = cellOf(v);
+        if (from == to) return;
+
+        // an inter edge joins neighbors
+        if (u != startNode && v != endNode && hierarchy.clusterOfNode(u) != hierarchy.clusterOfNode(v)) {
+            path.push_back(from);
+            return;
+        }
+
+        // otherwise both ends lie in one cluster
+        const uint c = u == startNode ? startCluster : hierarchy.clusterOfNode(u);
+        cluster.run(terrain, hierarchy.rectOf(c), from, to);
+        cluster.appendPath(to, path);
+    }
+
+    // euclidean distance to end, a lower bound of every abstract path
+    float heuristic(Cell p) const { return cellDistance(terrain, p, end); }
+};
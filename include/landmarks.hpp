@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "budget.hpp"
+#include "cost.hpp"
+#include "edge_costs.hpp"
+#include "neighborhood.hpp"
+#include "open_list.hpp"
+#include "terrain.hpp"
+#include "thread_pool.hpp"
+
+// ALT heuristic: exact distances from a few landmark cells to every cell
+//
+// For any cells p, t and landmark L the triangle inequality gives
+// d(p, t) >= |d(L, t) - d(L, p)|, the largest of these bounds is a consistent
+// heuristic that also sees the height costs the euclidean distance misses.
+// Tables are cell-major, the distances of one cell to all landmarks are adjacent.
+class Landmarks {
+public:
+    explicit Landmarks(const Terrain& terrain, uint count = 8) : terrain(terrain), count(std::max(1u, count)) {}
+
+    // the tables have to be built again before the next search
+    void invalidate() { table.clear(); }
+
+    bool isDirty() const { return table.empty(); }
+
+    // one full Dijkstra per landmark, landmarks are spread evenly along the border
+    // false if cancel was set before the tables were done, they stay dirty then
+    bool build(ThreadPool& pool, CancelFlag cancel = nullptr) {
+        const uint w = terrain.getWidth();
+        const uint h = terrain.getHeight();
+
+        // walk around the border clockwise from (0, 0)
+        const uint perimeter = 2 * (w - 1) + 2 * (h - 1);
+        cells.clear();
+        for (uint i = 0; i < count; ++i) {
+            uint d = uint(uint64_t(i) * perimeter / count);
+            if (d < w - 1)
+                cells.push_back(terrain.cellAt(d, 0));
+            else if ((d -= w - 1) < h - 1)
+                cells.push_back(terrain.cellAt(w - 1, d));
+            else if ((d -= h - 1) < w - 1)
+                cells.push_back(terrain.cellAt(w - 1 - d, h - 1));
+            else
+                cells.push_back(terrain.cellAt(0, h - 1 - (d - (w - 1))));
+        }
+
+        std::vector<std::vector<float>> distances(count);
+        pool.run(count, [&](uint, size_t i) { dijkstra(cells[i], distances[i], cancel); });
+        if (isCancelled(cancel))
+            return false;
+
+        // interleave into the cell-major table
+        table.resize(terrain.size() * count);
+        pool.run(h, [&](uint, size_t y) {
+            for (Cell c = terrain.cellAt(0, y); c < terrain.cellAt(0, y) + w; ++c)
+                for (uint i = 0; i < count; ++i)
+                    table[size_t(c) * count + i] = distances[i][c];
+        });
+        return true;
+    }
+
+    uint getCount() const { return count; }
+    const std::vector<Cell>& getCells() const { return cells; }
+
+    // distances of c to all landmarks
+    const float* row(Cell c) const { return &table[size_t(c) * count]; }
+
+    // lower bound of the distance from p to the cell whose row is target
+    float bound(Cell p, const float* target) const {
+        const float* d = row(p);
+        float b = 0.f;
+        for (uint i = 0; i < count; ++i)
+            b = std::max(b, std::abs(d[i] - target[i]));
+        return b;
+    }
+
+private:
+    const Terrain& terrain;
+    const uint count;  // number of landmarks
+
+    std::vector<Cell> cells;   // landmark cells
+    std::vector<float> table;  // distance of every cell to every landmark, empty if stale
+
+    // stops early once cancel is set, dist is incomplete then
+    void dijkstra(Cell from, std::vector<float>& dist, CancelFlag cancel) const {
+        if (isCancelled(cancel))
+            return;
+
+        dist.assign(terrain.size(), INFINITY);
+        DaryHeap<4, float> heap;
+        heap.resize(terrain.size());
+
+        const EdgeCosts edges(terrain);
+
+        dist[from] = 0;
+        heap.push(from, 0);
+
+        for (uint64_t i = 0; !heap.empty(); ++i) {
+            if ((i & 4095) == 0 && isCancelled(cancel))
+                return;
+
+            const Cell active = heap.top();
+            heap.pop();
+
+            forEachNeighborMove<8>(terrain, active, [&](Cell p, uint move) {
+                float d = dist[active] + edges.length(move, active, p);
+                if (d < dist[p]) {
+                    dist[p] = d;
+                    heap.push(p, d);
+                }
+            });
+        }
+    }
+};
@@ -1,264 +1,448 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
-#include <queue>
-#include <set>
+#include <memory>
 #include <vector>
 
+#include "change_log.hpp"
+#include "generator.hpp"
+#include "hierarchy.hpp"
+#include "landmarks.hpp"
 #include "perlin_noise.hpp"
+#include "replanner.hpp"
+#include "search.hpp"
+#include "terrain_file.hpp"
+#include "thread_pool.hpp"
+#include "terrain.hpp"
 
 using std::vector;
-typedef unsigned int uint;
 typedef unsigned char uchar;
 
+// new height of one cell, see Model::applyHeightEdits()
+struct HeightEdit {
+    uint x, y;
+    float elevation;  // rounded to the nearest level
+};
+
 class Model {
 public:
-    Model(uint width, uint height)
-        : width(width),
-          height(height),
-          terrain(height, vector<Point>(width, Point{})),
-          perlin(rand()),
-          heap(PointCompare(this)) {
-        // set coordinated of points
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                terrain[y][x].x = x;
-                terrain[y][x].y = y;
-            }
-        }
+    Model(uint width, uint height) : Model(width, height, rand()) {}
 
+    // threads run generation and table builds, 0 means one per hardware thread
+    Model(uint width, uint height, siv::PerlinNoise::seed_type seed, const GeneratorSettings& settings = {}, uint threads = 0)
+        : settings(settings),
+          width(width),
+          height(height),
+          terrain(width, height, settings.levels),
+          changes(changeLogCapacity()),
+          heightChanges(changeLogCapacity()),
+          landmarks(terrain),
+          seed(seed),
+          perlin(seed),
+          pool(threads) {
         // initial terrain creation
         fillPerlin();
     }
 
-    struct Point {
-        float height = 0.f;         // between [0, 1]
-        float distance = INFINITY;  // distance to start
-        bool visited = false;       // ignore when visited before
-        Point* prev = nullptr;      // previous point for shortest path
-        uint x = 0, y = 0;
-    };
-
-    struct PointCompare {
-        PointCompare(Model* model) : model(model) {}
-
-        Model* model;
-
-        bool operator()(const Point* l, const Point* r) const {
-            return (l->distance + model->heuristic(l)) < (r->distance + model->heuristic(r));
-        }
-    };
+    // loads a map saved with save(), throws std::runtime_error if it cannot be read
+    explicit Model(const std::string& path, uint threads = 0) : Model(std::make_shared<MappedTerrainFile>(path), threads) {}
+
+    // the terrain is the mapped file itself, pages are only read when cells are used
+    explicit Model(const std::shared_ptr<MappedTerrainFile>& file, uint threads = 0)
+        : settings(file->getSettings()),
+          width(file->getHeader().width),
+          height(file->getHeader().height),
+          terrain(width, height, settings.levels, file->getCells(), file),
+          changes(changeLogCapacity()),
+          heightChanges(changeLogCapacity()),
+          landmarks(terrain),
+          seed(file->getHeader().seed),
+          perlin(seed),
+          pool(threads) {}
+
+    // writes the map with its generator settings, throws std::runtime_error on failure
+    void save(const std::string& path) const { saveTerrainFile(path, terrain, settings, seed); }
+
+    // changes how noise is mapped to levels and generates the terrain again
+    void setNormalization(Normalization mode) {
+        settings.normalization = mode;
+        fillPerlin();
+        terrainChanged();
+        clearPathState();
+    }
 
     void regenerateTerrain() {
-        perlin.reseed(rand());  // new noise
-        fillPerlin();           // calc new terrain
+        seed = rand();
+        perlin.reseed(seed);  // new noise
+        fillPerlin();         // calc new terrain
+        terrainChanged();
         clearPathState();
-        start = nullptr;
-        end = nullptr;
+        start = noCell;
+        end = noCell;
     }
 
     void clearPathState() {
-        // cleanup Points
-        for (auto& row : terrain) {
-            for (auto& p : row) {
-                p.distance = INFINITY;
-                p.prev = nullptr;
-                p.visited = false;
+        if (search)
+            search->clear();
+        changes.markAll();
+        ++version;
+    }
+
+    // tables the search needs are built first, setting cancel stops that early
+    // false if it was cancelled, nothing is set up then and the tables are built next time
+    bool setupPathfinding(CancelFlag cancel = nullptr) {
+        ++version;
+        if (incremental) {
+            if (!replanner) {
+                replanner = std::make_unique<Replanner>(terrain);
+                replanner->setChangeLog(&changes);
             }
+
+            // a new end needs a new search tree, a new start keeps it
+            if (replanner->getGoal() != end) {
+                replanner->reset(start, end);
+                changes.markAll();
+            } else if (replanner->getStart() != start)
+                replanner->moveStart(start);
+
+            replanner->beginPlan();
+            return true;
         }
 
-        // clean queue
-        heap.clear();
+        if (!prepareSearch(cancel))
+            return false;
+        getSearch().setup(start, end);
+        changes.markAll();
+        return true;
     }
 
-    void setupPathfinding() {
-        start->distance = 0;
-        heap.insert(start);
+    Cell getBest() {
+        if (incremental)
+            return replanner && replanner->getGoal() != noCell ? replanner->getStart() : noCell;
+        return search ? search->getBest() : noCell;
     }
 
-    Point* getBest() {
-        if (heap.size())
-            return *heap.begin();
-        else
-            return nullptr;
+    bool iteratePathfinding() {
+        ++version;
+        if (incremental)
+            return replanner->iterate();
+        return getSearch().iterate();
     }
 
-    bool iteratePathfinding() {
-        // get top element from queue
-        Point* active = *heap.begin();
+    // continues the search from setupPathfinding() within a budget
+    // a long search can be spread over several frames this way
+    SearchProgress advancePathfinding(const SearchBudget& budget) {
+        ++version;
+        if (incremental)
+            return replanner->advance(budget);
+        return getSearch().advance(budget);
+    }
 
-        // if the active Point is the end, we're done!
-        if (active == end)
-            return true;
+    // runs a whole search from start to end, false if end is unreachable
+    bool findPath() {
+        ++version;
+        if (incremental) {
+            setupPathfinding();
+            return replanner->plan();
+        }
+
+        prepareSearch();
+        changes.markAll();
+        return getSearch().run(start, end);
+    }
 
-        heap.erase(heap.begin());
+    // number of cells expanded by the current search
+    uint64_t getExpansions() const {
+        if (incremental)
+            return replanner ? replanner->getExpansions() : 0;
+        return search ? search->getExpansions() : 0;
+    }
 
-        // get neighbors
-        auto neighbors = getNeighbors(active);
+    // changes whenever terrain, start, end or search state may have changed
+    // a viewer that saw the same version has nothing to redraw
+    uint64_t getVersion() const { return version; }
 
-        for (auto& p : neighbors) {
-            if (p->visited) continue;  // skip visited Points
+    // changes whenever heights changed
+    uint64_t getTerrainVersion() const { return terrainVersion; }
 
-            // new distanc to p
-            float dist = active->distance + distance(active, p);
+    // cells whose isVisited() or height changed since the last call, for a single viewer
+    // false if too much changed to list, everything has to be redrawn then
+    bool takeChangedCells(vector<Cell>& cells) { return changes.take(cells); }
 
-            // if distance is lower
-            if (dist < p->distance) {
-                p->distance = dist;
-                p->prev = active;
+    // cells whose height changed since the last call, for a single viewer
+    // false if the whole terrain changed
+    bool takeChangedHeights(vector<Cell>& cells) { return heightChanges.take(cells); }
 
-                // We have to remove the older point first and insert it again
-                // in order to reorganize the set with the new point value,
-                // since if we would just insert the already existing point,
-                // the set would not reorganize itself.
-                if (heap.contains(p))
-                    heap.erase(p);
-                heap.insert(p);
-            }
+    // incremental planning with D* Lite, moving the start or editing heights
+    // repairs the previous plan instead of searching again from scratch
+    void setIncremental(bool on) {
+        incremental = on;
+        clearPathState();
+    }
+
+    bool getIncremental() const { return incremental; }
+
+    // changes heights in place
+    // derived data is repaired where it can be and rebuilt lazily otherwise
+    void applyHeightEdits(const vector<HeightEdit>& edits) {
+        vector<Cell> changed;
+        for (const HeightEdit& e : edits) {
+            Cell c = terrain.cellAt(e.x, e.y);
+            const uint8_t level = terrain.nearestLevel(e.elevation);
+            if (terrain.getLevel(c) == level) continue;
+
+            terrain.setLevel(c, level);
+            changed.push_back(c);
+            changes.add(c);
+            heightChanges.add(c);
+            if (hierarchy)
+                hierarchy->markChanged(e.x, e.y);
         }
 
-        // Point is done, don't visit it anymore
-        active->visited = true;
+        if (changed.empty())
+            return;
+        ++version;
+        ++terrainVersion;
+
+        if (search)
+            search->terrainChanged();  // jump point tables
+        landmarks.invalidate();        // exact distances
+        if (replanner)
+            replanner->cellsChanged(changed);
+
+        // a plain search has to start over
+        if (!incremental)
+            clearPathState();
+    }
+
+    // HPA* abstraction of the terrain for long queries, built on first use
+    // changed clusters are rebuilt before it is handed out again
+    const Hierarchy& getHierarchy() {
+        if (!hierarchy)
+            hierarchy = std::make_unique<Hierarchy>(terrain);
+        if (hierarchy->isDirty())
+            hierarchy->rebuild(pool);
+        return *hierarchy;
+    }
 
-        return false;
+    // ALT heuristic, the landmark tables are built once per terrain on the next search
+    void setUseLandmarks(bool use) {
+        useLandmarks = use;
+        if (search)
+            search->setLandmarks(use ? &landmarks : nullptr);
     }
 
+    bool getUseLandmarks() const { return useLandmarks; }
+
+    // landmark tables of the current terrain
+    const Landmarks& getLandmarks() {
+        if (landmarks.isDirty())
+            landmarks.build(pool);
+        return landmarks;
+    }
+
+    // takes effect with the next search
+    void setSearchMode(SearchMode mode) {
+        searchMode = mode;
+        if (search)
+            search->setMode(mode);
+    }
+    SearchMode getSearchMode() const { return searchMode; }
+
     uint getWidth() { return width; }
     uint getHeight() { return height; }
 
-    Point* getPoint(uint x, uint y) {
-        return &(terrain[y][x]);
+    Cell getCell(uint x, uint y) const { return terrain.cellAt(x, y); }
+    uint getX(Cell c) const { return terrain.xOf(c); }
+    uint getY(Cell c) const { return terrain.yOf(c); }
+
+    const Terrain& getTerrain() const { return terrain; }
+    float getElevation(Cell c) const { return terrain.getElevation(c); }
+
+    // cost of the best path from start to end found so far, INFINITY if there is none
+    float getCost() const {
+        if (incremental)
+            return replanner && replanner->getGoal() != noCell ? replanner->getCost() : INFINITY;
+        return getDistance(end);
+    }
+
+    // search state of a cell, the distance to where the search began and the cell before it
+    // the incremental planner searches from end, so its distances are to end and prevs lead there
+    float getDistance(Cell c) const {
+        if (incremental)
+            return replanner && replanner->getGoal() != noCell ? replanner->getDistance(c) : INFINITY;
+        return search && c != noCell ? search->getDistance(c) : INFINITY;
+    }
+
+    Cell getPrev(Cell c) const {
+        if (incremental)
+            return replanner && replanner->getGoal() != noCell ? replanner->getNext(c) : noCell;
+        return search ? search->getPrev(c) : noCell;
+    }
+    bool isVisited(Cell c) const {
+        if (incremental)
+            return replanner && replanner->isVisited(c);
+        return search && search->isVisited(c);
+    }
+
+    uint getPathLength() const {
+        if (incremental)
+            return replanner ? replanner->getPathLength() : 0;
+        return search ? search->getPathLength() : 0;
     }
 
-    void setStart(Point* p) {
-        if (heap.size())  // clear if there is already a path
+    // calls f(cell) for every cell on the path from c back to start
+    // the incremental planner only knows the path of its current start
+    template <class F>
+    void forEachPathCell(Cell c, F&& f) const {
+        if (incremental) {
+            if (replanner)
+                replanner->forEachPathCell(f);
+            return;
+        }
+        if (search)
+            search->forEachPathCell(c, f);
+    }
+
+    void setStart(Cell c) {
+        if (!incremental && search && search->isDirty())  // clear if there is already a path
             clearPathState();
-        start = p;
+        start = c;
+        ++version;
     }
 
-    void setEnd(Point* p) {
-        if (heap.size())  // clear if there is already a path
+    void setEnd(Cell c) {
+        if (!incremental && search && search->isDirty())  // clear if there is already a path
             clearPathState();
-        end = p;
+        end = c;
+        ++version;
     }
 
-    Point* getStart() { return start; }
-    Point* getEnd() { return end; }
+    Cell getStart() { return start; }
+    Cell getEnd() { return end; }
 
 private:
-    float heightCostMult = 200.f;  // multiplier for heigth cost in 3d euclidean distance calculation
-    uint octaves = 20;             // how many octaves
-    double stepSize = 0.03;        // multiplier for x and y values, to reduce step size
-    double persistence = 0.4;      // how much the value of the next octave is reduced
-    uint levels = 14;
+    GeneratorSettings settings;  // noise parameters and levels
 
-    const uint width, height;       // size of the terrain
-    vector<vector<Point>> terrain;  // terrain itself
+    const uint width, height;  // size of the terrain
+    Terrain terrain;           // static height field
+    ChangeLog changes;         // cells the search changed, see takeChangedCells()
+    ChangeLog heightChanges;   // see takeChangedHeights()
+    Landmarks landmarks;       // ALT tables, built on first use
+    bool useLandmarks = false;
 
-    Point* start = nullptr;  // search from here
-    Point* end = nullptr;    // find path from start to end
+    std::unique_ptr<Search> search;  // interactive query, null until the first search
+    SearchMode searchMode = SearchMode::AStar;
 
-    siv::PerlinNoise perlin;  // current noise generator
+    Cell start = noCell;  // search from here
+    Cell end = noCell;    // find path from start to end
 
-    std::set<Point*, PointCompare> heap;
+    siv::PerlinNoise::seed_type seed;  // of the current noise
+    siv::PerlinNoise perlin;           // current noise generator
+    ThreadPool pool;                   // terrain generation and table builds
 
-    void fillPerlin() {
-        double lower = 2.0;   // 1 is max of [0, 1], so 2 is bigger
-        double upper = -1.0;  // -1 because 0 is minimal val
-
-        // set noise of terrain
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                double noise = perlin.octave2D_01(x * stepSize, y * stepSize, octaves, persistence);
-                if (noise < lower) lower = noise;
-                if (noise > upper) upper = noise;
-                terrain[y][x].height = noise;
-            }
-        }
+    std::unique_ptr<Hierarchy> hierarchy;  // null until the first hierarchical query
 
-        // rescale terrain so that its between [0, 1]
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                terrain[y][x].height = (terrain[y][x].height - lower) / (upper - lower);
-            }
-        }
+    std::unique_ptr<Replanner> replanner;  // null until the first incremental plan
+    bool incremental = false;
 
-        // cluster terrain into levels
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int step = int(terrain[y][x].height * levels);           // step is (int[0, levels])
-                if (step == levels) step = levels - 1;                   // int[0, levels-1]
-                terrain[y][x].height = float(step) / float(levels - 1);  // [0, 1]
-            }
+    uint64_t version = 0;         // see getVersion()
+    uint64_t terrainVersion = 0;  // see getTerrainVersion()
+
+    // a log longer than this costs about as much as redrawing everything
+    size_t changeLogCapacity() const { return std::max<size_t>(size_t(width) * height / 16, 4096); }
+
+    // a Search needs about 24 bytes per cell, a model that only serves its terrain never makes one
+    Search& getSearch() {
+        if (!search) {
+            search = std::make_unique<Search>(terrain);
+            search->setMode(searchMode);
+            search->setLandmarks(useLandmarks ? &landmarks : nullptr);
+            search->setChangeLog(&changes);
         }
+        return *search;
     }
 
-    // euclidean distance from p to end
-    float heuristic(const Point* p) {
-        return distance(p, end);
+    // false if cancelled before the tables were done
+    bool prepareSearch(CancelFlag cancel = nullptr) {
+        if (useLandmarks && landmarks.isDirty() && !landmarks.build(pool, cancel))
+            return false;
+        return getSearch().prepare(cancel);
     }
 
-    // euclidean distance between points where height is the 3rd dimension
-    float distance(const Point* p1, const Point* p2) {
-        float dx = float(p1->x) - float(p2->x);
-        float dy = float(p1->y) - float(p2->y);
-        float dz = float(p1->height) - float(p2->height);
-        dz *= heightCostMult;
-        return sqrtf(dx * dx + dy * dy + dz * dz);
+    // drops everything derived from the whole terrain
+    void terrainChanged() {
+        if (search)
+            search->terrainChanged();
+        landmarks.invalidate();
+        if (hierarchy)
+            hierarchy->invalidate();
+        if (replanner)
+            replanner->invalidate();
+        changes.markAll();
+        heightChanges.markAll();
+        ++version;
+        ++terrainVersion;
     }
 
-    // get neighbors of point p
-    vector<Point*> getNeighbors(const Point* p) {
-        vector<Point*> res;
-
-        uint x = p->x;
-        uint y = p->y;
-
-        if (y > 0) {
-            res.push_back(&terrain[y - 1][x]);
-
-            if (y < height - 1) {
-                res.push_back(&terrain[y + 1][x]);
-
-                if (x > 0) {
-                    res.push_back(&terrain[y - 1][x - 1]);
-                    res.push_back(&terrain[y][x - 1]);
-                    res.push_back(&terrain[y + 1][x - 1]);
-                }
-
-                if (x < width - 1) {
-                    res.push_back(&terrain[y - 1][x + 1]);
-                    res.push_back(&terrain[y][x + 1]);
-                    res.push_back(&terrain[y + 1][x + 1]);
-                }
-
-            } else {
-                if (x > 0) {
-                    res.push_back(&terrain[y - 1][x - 1]);
-                    res.push_back(&terrain[y][x - 1]);
-                }
-
-                if (x < width - 1) {
-                    res.push_back(&terrain[y - 1][x + 1]);
-                    res.push_back(&terrain[y][x + 1]);
-                }
-            }
-        } else {
-            res.push_back(&terrain[y + 1][x]);
+    void fillPerlin() {
+        vector<vector<double>> noise(pool.size(), vector<double>(width));  // row buffer per worker
+
+        // bounds known up front, so rows are finished in a single pass
+        if (settings.normalization != Normalization::MapBounds) {
+            NoiseBounds bounds = independentBounds(perlin, settings);
+            pool.run(height, [&](uint worker, size_t y) {
+                generateRow(perlin, settings, bounds, 0.0, y, terrain.row(y), width, noise[worker].data());
+            });
+            return;
+        }
 
-            if (x > 0) {
-                res.push_back(&terrain[y][x - 1]);
-                res.push_back(&terrain[y + 1][x - 1]);
+        // per worker bounds of the raw noise, padded against false sharing
+        struct alignas(64) Bounds {
+            double lower = 2.0;   // 1 is max of [0, 1], so 2 is bigger
+            double upper = -1.0;  // -1 because 0 is minimal val
+        };
+        vector<Bounds> bounds(pool.size());
+
+        // raw noise until the bounds are known, the terrain only holds levels
+        vector<float> raw(size_t(width) * height);
+
+        // set noise of terrain, rows are spread over all cores
+        pool.run(height, [&](uint worker, size_t y) {
+            float* row = &raw[y * width];
+            Bounds& b = bounds[worker];
+
+            // whole row at once with the batch noise kernel
+            perlin.octave2DRow_01(0.0, settings.stepSize, y * settings.stepSize, settings.octaves, settings.persistence,
+                                  noise[worker].data(), width);
+
+            for (uint x = 0; x < width; ++x) {
+                double n = noise[worker][x];
+                if (n < b.lower) b.lower = n;
+                if (n > b.upper) b.upper = n;
+                row[x] = n;
             }
+        });
 
-            if (x < width - 1) {
-                res.push_back(&terrain[y][x + 1]);
-                res.push_back(&terrain[y + 1][x + 1]);
-            }
+        double lower = 2.0;
+        double upper = -1.0;
+        for (const Bounds& b : bounds) {
+            if (b.lower < lower) lower = b.lower;
+            if (b.upper > upper) upper = b.upper;
         }
 
-        return res;
+        // rescale terrain to [0, 1] and cluster it into levels in one pass
+        pool.run(height, [&](uint, size_t y) {
+            const float* noiseRow = &raw[y * width];
+            uint8_t* row = terrain.row(y);
+            for (uint x = 0; x < width; ++x) {
+                float value = (noiseRow[x] - lower) / (upper - lower);  // [0, 1]
+                row[x] = quantizeLevel(value, settings.levels);
+            }
+        });
     }
 };
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "terrain.hpp"
+
+// relative position of a neighbor
+struct Offset {
+    int dx, dy;
+};
+
+// moves to a neighbor have one of three planar lengths: 1, sqrt 2 and sqrt 5
+constexpr uint moveClasses = 3;
+
+constexpr uint moveClass(int dx, int dy) {
+    return dx * dx + dy * dy == 1 ? 0 : dx * dx + dy * dy == 2 ? 1 : 2;
+}
+
+// neighbor offsets of a grid connectivity, only 4, 8 and 16 are defined
+template <uint Connectivity>
+struct Neighborhood;
+
+template <>
+struct Neighborhood<4> {
+    static constexpr uint reach = 1;  // max |dx| or |dy|
+    static constexpr std::array<Offset, 4> offsets{{{0, -1}, {-1, 0}, {1, 0}, {0, 1}}};
+};
+
+template <>
+struct Neighborhood<8> {
+    static constexpr uint reach = 1;
+    static constexpr std::array<Offset, 8> offsets{{{-1, -1}, {0, -1}, {1, -1},
+                                                    {-1, 0}, {1, 0},
+                                                    {-1, 1}, {0, 1}, {1, 1}}};
+};
+
+// 8-neighborhood plus the knight moves
+template <>
+struct Neighborhood<16> {
+    static constexpr uint reach = 2;
+    static constexpr std::array<Offset, 16> offsets{{{-1, -1}, {0, -1}, {1, -1},
+                                                     {-1, 0}, {1, 0},
+                                                     {-1, 1}, {0, 1}, {1, 1},
+                                                     {-1, -2}, {1, -2}, {-2, -1}, {2, -1},
+                                                     {-2, 1}, {2, 1}, {-1, 2}, {1, 2}}};
+};
+
+// calls f(neighbor, move) for every neighbor of c inside the terrain, move is its moveClass()
+// the offsets are expanded at compile time and nothing is allocated, so move is a constant;
+// cells away from the border skip the bounds checks entirely
+template <uint Connectivity, class F>
+inline void forEachNeighborMove(const Terrain& terrain, Cell c, F&& f) {
+    using N = Neighborhood<Connectivity>;
+    constexpr uint r = N::reach;
+
+    const uint w = terrain.getWidth();
+    const uint h = terrain.getHeight();
+    const uint x = terrain.xOf(c);
+    const uint y = terrain.yOf(c);
+
+    if (x >= r && y >= r && x + r < w && y + r < h) {
+        // interior, neighbors are plain index offsets
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (f(Cell(int64_t(c) + N::offsets[I].dy * int64_t(w) + N::offsets[I].dx),
+               moveClass(N::offsets[I].dx, N::offsets[I].dy)),
+             ...);
+        }(std::make_index_sequence<N::offsets.size()>{});
+    } else {
+        // border, negative coordinates wrap around and fail the check as well
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (
+                [&] {
+                    uint nx = x + N::offsets[I].dx;
+                    uint ny = y + N::offsets[I].dy;
+                    if (nx < w && ny < h)
+                        f(terrain.cellAt(nx, ny), moveClass(N::offsets[I].dx, N::offsets[I].dy));
+                }(),
+                ...);
+        }(std::make_index_sequence<N::offsets.size()>{});
+    }
+}
+
+// calls f(neighbor) for every neighbor of c inside the terrain
+template <uint Connectivity, class F>
+inline void forEachNeighbor(const Terrain& terrain, Cell c, F&& f) {
+    forEachNeighborMove<Connectivity>(terrain, c, [&](Cell n, uint) { f(n); });
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Open lists for the A* search.
+// Entries are dense ids in [0, capacity) together with a cached key (the f-score),
+// so ordering never has to recompute the heuristic.
+// Both containers share the same interface, so they can be swapped for benchmarks.
+
+// indexed d-ary min-heap with decrease-key
+template <unsigned Arity, class Key>
+class DaryHeap {
+public:
+    static_assert(Arity >= 2, "a heap needs at least two children per node");
+
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    // ids have to be in [0, capacity)
+    void resize(uint32_t capacity) {
+        entries.clear();
+        pos.assign(capacity, npos);
+    }
+
+    // raises the capacity, keeps queued entries
+    void grow(uint32_t capacity) {
+        if (capacity > pos.size())
+            pos.resize(capacity, npos);
+    }
+
+    bool empty() const { return entries.empty(); }
+    size_t size() const { return entries.size(); }
+
+    bool contains(uint32_t id) const { return pos[id] != npos; }
+
+    uint32_t top() const { return entries.front().id; }
+    Key topKey() const { return entries.front().key; }
+
+    void pop() {
+        pos[entries.front().id] = npos;
+
+        Entry last = entries.back();
+        entries.pop_back();
+
+        if (!entries.empty())
+            siftDown(0, last);
+    }
+
+    // insert id, or lower its key if it is already queued
+    void push(uint32_t id, Key key) {
+        uint32_t i = pos[id];
+
+        if (i == npos) {
+            i = uint32_t(entries.size());
+            entries.push_back({key, id});  // storage is kept across clear(), so this rarely allocates
+        } else if (!(key < entries[i].key)) {
+            return;  // only decrease-key is supported
+        }
+
+        siftUp(i, {key, id});
+    }
+
+    // insert id, or set its key if it is already queued, the key may also rise
+    void update(uint32_t id, Key key) {
+        const uint32_t i = pos[id];
+
+        if (i == npos)
+            push(id, key);
+        else if (key < entries[i].key)
+            siftUp(i, {key, id});
+        else
+            siftDown(i, {key, id});
+    }
+
+    // takes id out of the queue if it is queued
+    void remove(uint32_t id) {
+        const uint32_t i = pos[id];
+        if (i == npos) return;
+
+        pos[id] = npos;
+        Entry last = entries.back();
+        entries.pop_back();
+
+        // the last entry fills the gap, it may belong above or below it
+        if (i < entries.size()) {
+            if (i > 0 && last.key < entries[(i - 1) / Arity].key)
+                siftUp(i, last);
+            else
+                siftDown(i, last);
+        }
+    }
+
+    // only touches the queued entries, not the whole id range
+    void clear() {
+        for (const Entry& e : entries)
+            pos[e.id] = npos;
+        entries.clear();
+    }
+
+private:
+    struct Entry {
+        Key key;
+        uint32_t id;
+    };
+
+    std::vector<Entry> entries;  // implicit d-ary tree
+    std::vector<uint32_t> pos;   // index of every id in entries, npos if not queued
+
+    void place(uint32_t i, const Entry& e) {
+        entries[i] = e;
+        pos[e.id] = i;
+    }
+
+    void siftUp(uint32_t i, Entry e) {
+        while (i > 0) {
+            uint32_t parent = (i - 1) / Arity;
+            if (!(e.key < entries[parent].key)) break;
+            place(i, entries[parent]);
+            i = parent;
+        }
+        place(i, e);
+    }
+
+    void siftDown(uint32_t i, Entry e) {
+        const uint32_t n = uint32_t(entries.size());
+
+        while (true) {
+            uint32_t first = i * Arity + 1;
+            if (first >= n) break;
+
+            uint32_t last = first + Arity < n ? first + Arity : n;
+
+            // smallest child
+            uint32_t best = first;
+            for (uint32_t c = first + 1; c < last; ++c)
+                if (entries[c].key < entries[best].key) best = c;
+
+            if (!(entries[best].key < e.key)) break;
+            place(i, entries[best]);
+            i = best;
+        }
+        place(i, e);
+    }
+};
+
+// reference open list on top of std::set, one node allocation per push
+template <class Key>
+class SetOpenList {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    void resize(uint32_t capacity) {
+        set.clear();
+        keys.assign(capacity, Key{});
+        queued.assign(capacity, false);
+    }
+
+    void grow(uint32_t capacity) {
+        if (capacity > keys.size()) {
+            keys.resize(capacity, Key{});
+            queued.resize(capacity, false);
+        }
+    }
+
+    bool empty() const { return set.empty(); }
+    size_t size() const { return set.size(); }
+
+    bool contains(uint32_t id) const { return queued[id]; }
+
+    uint32_t top() const { return set.begin()->second; }
+    Key topKey() const { return set.begin()->first; }
+
+    void pop() {
+        queued[set.begin()->second] = false;
+        set.erase(set.begin());
+    }
+
+    void push(uint32_t id, Key key) {
+        if (queued[id]) {
+            if (!(key < keys[id])) return;
+            set.erase({keys[id], id});
+        }
+
+        keys[id] = key;
+        queued[id] = true;
+        set.insert({key, id});
+    }
+
+    void update(uint32_t id, Key key) {
+        if (queued[id])
+            set.erase({keys[id], id});
+
+        keys[id] = key;
+        queued[id] = true;
+        set.insert({key, id});
+    }
+
+    void remove(uint32_t id) {
+        if (!queued[id]) return;
+
+        set.erase({keys[id], id});
+        queued[id] = false;
+    }
+
+    void clear() {
+        for (auto& e : set)
+            queued[e.second] = false;
+        set.clear();
+    }
+
+private:
+    std::set<std::pair<Key, uint32_t>> set;  // ordered by key, ties broken by id
+    std::vector<Key> keys;                   // key of every queued id
+    std::vector<bool> queued;
+};
+
+// open list used by the searches, build with -DPATH_SET_OPEN_LIST to compare against std::set
+#ifdef PATH_SET_OPEN_LIST
+template <class Key>
+using OpenListOf = SetOpenList<Key>;
+#else
+template <class Key>
+using OpenListOf = DaryHeap<4, Key>;
+#endif
+
+using OpenList = OpenListOf<float>;
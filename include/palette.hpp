@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+// colors of the map view, shared by the window and snapshots
+struct Rgb {
+    uint8_t r, g, b;
+};
+
+const Rgb startColor = {0, 255, 0};
+const Rgb endColor = {255, 0, 0};
+
+// gray by height, cells the search visited in a greener shade
+inline Rgb terrainColor(float elevation, bool visited) {
+    const uint8_t v = uint8_t(elevation * 255);
+    return {visited ? uint8_t(v * 0.7f) : v, v, v};
+}
+
+// red on high ground, blue on low ground
+inline Rgb pathColor(float elevation) {
+    return {uint8_t(255 * elevation), 90, uint8_t(255 * (1.f - elevation))};
+}
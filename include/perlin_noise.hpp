@@ -28,6 +28,8 @@
 #pragma once
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <iterator>
 #include <numeric>
@@ -206,6 +208,23 @@ public:
 
     [[nodiscard]] value_type normalizedOctave3D_01(value_type x, value_type y, value_type z, std::int32_t octaves, value_type persistence = value_type(0.5)) const noexcept;
 
+    ///////////////////////////////////////
+    //
+    //	Batch octave noise over a row of samples
+    //	out[i] = octave2D((first + i) * step, y, octaves, persistence) for i in [0, count)
+    //
+    //	The constant z of noise2D() is folded into per-corner 2D gradients, so each sample
+    //	only evaluates four corners. Samples are processed in blocks whose arithmetic is
+    //	vectorized into SSE/AVX lanes. Results match the scalar functions up to rounding.
+    //
+
+    template <class Out>
+    void octave2DRow(value_type first, value_type step, value_type y, std::int32_t octaves, value_type persistence, Out* out, std::size_t count) const noexcept;
+
+    // The result is clamped and remapped to the range [0, 1]
+    template <class Out>
+    void octave2DRow_01(value_type first, value_type step, value_type y, std::int32_t octaves, value_type persistence, Out* out, std::size_t count) const noexcept;
+
 private:
     state_type m_permutation;
 };
@@ -258,6 +277,13 @@ template <class Float>
     return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
 }
 
+// noise repeats every 256 units, wrapping keeps the lattice index in range for far away coordinates
+// exact, so it does not change any result
+template <class Float>
+[[nodiscard]] inline Float WrapPeriod(const Float x) noexcept {
+    return x - Float(256) * std::floor(x / Float(256));
+}
+
 template <class Float>
 [[nodiscard]] inline constexpr Float Remap_01(const Float x) noexcept {
     return (x * Float(0.5) + Float(0.5));
@@ -340,6 +366,103 @@ template <class Float>
 
     return result;
 }
+
+// gradient of a lattice column with the constant z of noise2D() folded in
+// Lerp(Grad(h0, x, y, fz), Grad(h1, x, y, fz - 1), w) == gx * x + gy * y + gc
+template <class Float>
+struct Gradient2D {
+    Float gx, gy, gc;
+};
+
+template <class Float>
+[[nodiscard]] inline constexpr Gradient2D<Float> FoldGrad(const std::uint8_t h0, const std::uint8_t h1, const Float fz, const Float w) noexcept {
+    // Grad() is linear in x, y and z, so its coefficients are its values at the unit vectors
+    return {Lerp(Grad(h0, Float(1), Float(0), Float(0)), Grad(h1, Float(1), Float(0), Float(0)), w),
+            Lerp(Grad(h0, Float(0), Float(1), Float(0)), Grad(h1, Float(0), Float(1), Float(0)), w),
+            Lerp(Grad(h0, Float(0), Float(0), fz), Grad(h1, Float(0), Float(0), fz - 1), w)};
+}
+
+template <class Float, class Out>
+inline void Octave2DRow(const std::array<std::uint8_t, 256>& perm, const Float first, const Float step, const Float y, const std::int32_t octaves, const Float persistence, Out* out, const std::size_t count, const bool remap01) noexcept {
+    using value_type = Float;
+
+    // samples per block, arrays of a block are processed lane by lane
+    constexpr std::size_t Block = 32;
+
+    const value_type z = static_cast<value_type>(SIVPERLIN_DEFAULT_Z);
+    const value_type _z = std::floor(z);
+    const std::int32_t iz = static_cast<std::int32_t>(_z) & 255;
+    const value_type fz = (z - _z);
+    const value_type w = Fade(fz);
+
+    // folded gradients, indexed like AA in noise3D()
+    std::array<Gradient2D<value_type>, 256> grads;
+    for (std::size_t i = 0; i < 256; ++i) {
+        grads[i] = FoldGrad(perm[i], perm[(i + 1) & 255], fz, w);
+    }
+
+    for (std::size_t begin = 0; begin < count; begin += Block) {
+        const std::size_t n = std::min(Block, count - begin);
+
+        value_type xs[Block];
+        value_type sum[Block];
+        for (std::size_t i = 0; i < n; ++i) {
+            xs[i] = WrapPeriod((first + static_cast<value_type>(begin + i)) * step);
+            sum[i] = 0;
+        }
+
+        value_type yo = WrapPeriod(y);
+        value_type amplitude = 1;
+
+        for (std::int32_t octave = 0; octave < octaves; ++octave) {
+            // y is shared by the whole row
+            const value_type _y = std::floor(yo);
+            const std::int32_t iy = static_cast<std::int32_t>(_y) & 255;
+            const value_type fy = (yo - _y);
+            const value_type v = Fade(fy);
+
+            // hashing and table lookups, one lane at a time
+            value_type fx[Block];
+            Gradient2D<value_type> g00[Block], g10[Block], g01[Block], g11[Block];
+            for (std::size_t i = 0; i < n; ++i) {
+                const value_type _x = std::floor(xs[i]);
+                const std::int32_t ix = static_cast<std::int32_t>(_x) & 255;
+                fx[i] = (xs[i] - _x);
+
+                const std::uint8_t A = (perm[ix] + iy) & 255;
+                const std::uint8_t B = (perm[(ix + 1) & 255] + iy) & 255;
+
+                g00[i] = grads[(perm[A] + iz) & 255];
+                g01[i] = grads[(perm[(A + 1) & 255] + iz) & 255];
+                g10[i] = grads[(perm[B] + iz) & 255];
+                g11[i] = grads[(perm[(B + 1) & 255] + iz) & 255];
+            }
+
+            // four corner bilinear kernel, independent per lane so it vectorizes
+            for (std::size_t i = 0; i < n; ++i) {
+                const value_type u = Fade(fx[i]);
+
+                const value_type p0 = g00[i].gx * fx[i] + g00[i].gy * fy + g00[i].gc;
+                const value_type p1 = g10[i].gx * (fx[i] - 1) + g10[i].gy * fy + g10[i].gc;
+                const value_type p2 = g01[i].gx * fx[i] + g01[i].gy * (fy - 1) + g01[i].gc;
+                const value_type p3 = g11[i].gx * (fx[i] - 1) + g11[i].gy * (fy - 1) + g11[i].gc;
+
+                const value_type q0 = Lerp(p0, p1, u);
+                const value_type q1 = Lerp(p2, p3, u);
+
+                sum[i] += Lerp(q0, q1, v) * amplitude;
+                xs[i] = WrapPeriod(xs[i] * 2);
+            }
+
+            yo = WrapPeriod(yo * 2);
+            amplitude *= persistence;
+        }
+
+        for (std::size_t i = 0; i < n; ++i) {
+            out[begin + i] = static_cast<Out>(remap01 ? RemapClamp_01(sum[i]) : sum[i]);
+        }
+    }
+}
 }  // namespace perlin_detail
 
 ///////////////////////////////////////
@@ -560,6 +683,20 @@ template <class Float>
 inline typename BasicPerlinNoise<Float>::value_type BasicPerlinNoise<Float>::normalizedOctave3D_01(const value_type x, const value_type y, const value_type z, const std::int32_t octaves, const value_type persistence) const noexcept {
     return perlin_detail::Remap_01(normalizedOctave3D(x, y, z, octaves, persistence));
 }
+
+///////////////////////////////////////
+
+template <class Float>
+template <class Out>
+inline void BasicPerlinNoise<Float>::octave2DRow(const value_type first, const value_type step, const value_type y, const std::int32_t octaves, const value_type persistence, Out* out, const std::size_t count) const noexcept {
+    perlin_detail::Octave2DRow(m_permutation, first, step, y, octaves, persistence, out, count, false);
+}
+
+template <class Float>
+template <class Out>
+inline void BasicPerlinNoise<Float>::octave2DRow_01(const value_type first, const value_type step, const value_type y, const std::int32_t octaves, const value_type persistence, Out* out, const std::size_t count) const noexcept {
+    perlin_detail::Octave2DRow(m_permutation, first, step, y, octaves, persistence, out, count, true);
+}
 }  // namespace siv
 
 #undef SIVPERLIN_NODISCARD_CXX20
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// streams an 8 bit RGB png to disk row by row, no image is kept in memory
+//
+// Rows are stored with the png Sub filter, so a run of equal pixels becomes a run of zero
+// bytes. Deflate uses one block with the fixed huffman code and only emits matches at
+// distance 1, which is all it takes to shrink the flat plateaus of banded terrain to a few
+// bits per row. Compressed data goes out in IDAT chunks of at most chunkSize bytes.
+class PngWriter {
+public:
+    // false from good() if the file cannot be created
+    PngWriter(const std::string& path, uint32_t width, uint32_t height) : width(width), height(height) {
+        file = std::fopen(path.c_str(), "wb");
+        if (!file)
+            return;
+
+        static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        std::fwrite(signature, 1, sizeof(signature), file);
+
+        uint8_t header[13];
+        putBigEndian(header, width);
+        putBigEndian(header + 4, height);
+        header[8] = 8;   // bits per channel
+        header[9] = 2;   // RGB
+        header[10] = 0;  // deflate
+        header[11] = 0;  // adaptive filters
+        header[12] = 0;  // no interlace
+        writeChunk("IHDR", header, sizeof(header));
+
+        // zlib header: deflate with 32K window, no dictionary, then one final fixed huffman block
+        out.push_back(0x78);
+        out.push_back(0x01);
+        putBits(1, 1);
+        putBits(1, 2);
+    }
+
+    ~PngWriter() { finish(); }
+
+    PngWriter(const PngWriter&) = delete;
+    PngWriter& operator=(const PngWriter&) = delete;
+
+    bool good() const { return file && !std::ferror(file); }
+
+    // appends the next row, width RGB triples
+    void writeRow(const uint8_t* rgb) {
+        if (!file || rows == height)
+            return;
+
+        // Sub filter: every byte minus the same channel of the pixel to its left
+        filtered.resize(1 + size_t(width) * 3);
+        filtered[0] = 1;
+        for (size_t i = 0; i < size_t(width) * 3; ++i)
+            filtered[1 + i] = uint8_t(rgb[i] - (i >= 3 ? rgb[i - 3] : 0));
+
+        compressRow();
+        ++rows;
+
+        if (out.size() >= chunkSize)
+            flushData(false);
+    }
+
+    // completes the file, missing rows are written black
+    // returns false if writing failed
+    bool finish() {
+        if (!file)
+            return false;
+
+        if (rows < height) {
+            std::vector<uint8_t> black(size_t(width) * 3, 0);
+            while (rows < height)
+                writeRow(black.data());
+        }
+
+        putSymbol(256);  // end of block
+        if (bitCount)
+            putBits(0, 8 - bitCount);  // pad to a whole byte
+
+        uint8_t adler[4];
+        putBigEndian(adler, (adlerB << 16) | adlerA);
+        out.insert(out.end(), adler, adler + 4);
+        flushData(true);
+
+        writeChunk("IEND", nullptr, 0);
+
+        const bool ok = good();
+        std::fclose(file);
+        file = nullptr;
+        return ok;
+    }
+
+private:
+    static constexpr size_t chunkSize = 1 << 16;
+
+    std::FILE* file = nullptr;
+    const uint32_t width;
+    const uint32_t height;
+    uint32_t rows = 0;  // rows written so far
+
+    std::vector<uint8_t> filtered;  // current row with its filter byte
+    std::vector<uint8_t> out;       // compressed bytes not written yet
+
+    uint32_t bitBuffer = 0;  // bits not yet in out, least significant first
+    uint32_t bitCount = 0;
+
+    uint32_t adlerA = 1, adlerB = 0;  // adler32 of all uncompressed bytes
+
+    static void putBigEndian(uint8_t* p, uint32_t v) {
+        p[0] = uint8_t(v >> 24);
+        p[1] = uint8_t(v >> 16);
+        p[2] = uint8_t(v >> 8);
+        p[3] = uint8_t(v);
+    }
+
+    static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size) {
+        static const std::vector<uint32_t> table = [] {
+            std::vector<uint32_t> t(256);
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k)
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                t[n] = c;
+            }
+            return t;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void writeChunk(const char* type, const uint8_t* data, size_t size) {
+        uint8_t length[4];
+        putBigEndian(length, uint32_t(size));
+        std::fwrite(length, 1, 4, file);
+        std::fwrite(type, 1, 4, file);
+        if (size)
+            std::fwrite(data, 1, size, file);
+
+        uint32_t crc = crc32(0, reinterpret_cast<const uint8_t*>(type), 4);
+        crc = crc32(crc, data, size);
+        uint8_t check[4];
+        putBigEndian(check, crc);
+        std::fwrite(check, 1, 4, file);
+    }
+
+    // writes whole chunks, the rest stays for later unless this is the end
+    void flushData(bool last) {
+        size_t done = 0;
+        while (out.size() - done >= chunkSize || (last && done < out.size())) {
+            const size_t size = std::min(chunkSize, out.size() - done);
+            writeChunk("IDAT", out.data() + done, size);
+            done += size;
+        }
+        out.erase(out.begin(), out.begin() + done);
+    }
+
+    // deflate bit order: values least significant bit first
+    void putBits(uint32_t value, uint32_t count) {
+        bitBuffer |= value << bitCount;
+        bitCount += count;
+        while (bitCount >= 8) {
+            out.push_back(uint8_t(bitBuffer));
+            bitBuffer >>= 8;
+            bitCount -= 8;
+        }
+    }
+
+    // huffman codes go out most significant bit first
+    void putCode(uint32_t code, uint32_t length) {
+        uint32_t reversed = 0;
+        for (uint32_t i = 0; i < length; ++i)
+            reversed |= ((code >> i) & 1) << (length - 1 - i);
+        putBits(reversed, length);
+    }
+
+    // literal or length symbol of the fixed huffman code
+    void putSymbol(uint32_t symbol) {
+        if (symbol < 144)
+            putCode(0x30 + symbol, 8);
+        else if (symbol < 256)
+            putCode(0x190 + symbol - 144, 9);
+        else if (symbol < 280)
+            putCode(symbol - 256, 7);
+        else
+            putCode(0xc0 + symbol - 280, 8);
+    }
+
+    // repeats the previous byte length times, 3 <= length <= 258
+    void putRepeat(uint32_t length) {
+        static const uint16_t base[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                          31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                          2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+        uint32_t code = 28;
+        while (base[code] > length)
+            --code;
+        putSymbol(257 + code);
+        putBits(length - base[code], extra[code]);
+        putCode(0, 5);  // distance 1
+    }
+
+    void compressRow() {
+        const uint8_t* data = filtered.data();
+        const size_t size = filtered.size();
+
+        for (size_t i = 0; i < size;) {
+            size_t run = 1;
+            while (i + run < size && data[i + run] == data[i])
+                ++run;
+
+            putSymbol(data[i]);
+            size_t left = run - 1;
+            while (left >= 3) {
+                const uint32_t length = uint32_t(std::min<size_t>(left, 258));
+                putRepeat(length);
+                left -= length;
+            }
+            for (; left; --left)
+                putSymbol(data[i]);
+
+            i += run;
+        }
+
+        // adler32, the sums are reduced often enough that they cannot overflow
+        for (size_t i = 0; i < size;) {
+            const size_t end = std::min(size, i + 5552);
+            for (; i < end; ++i) {
+                adlerA += data[i];
+                adlerB += adlerA;
+            }
+            adlerA %= 65521;
+            adlerB %= 65521;
+        }
+    }
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "hierarchy.hpp"
+#include "search.hpp"
+#include "terrain.hpp"
+#include "thread_pool.hpp"
+
+struct Query {
+    Cell start, end;
+};
+
+struct QueryResult {
+    float cost = INFINITY;    // distance from start to end, INFINITY if unreachable
+    uint length = 0;          // number of steps on the path
+    uint64_t expansions = 0;  // cells expanded by the search
+    bool complete = true;     // false if the budget ran out first, cost and length are unknown then
+};
+
+// answers batches of independent queries in parallel on one shared terrain
+// the terrain is only read, every worker owns its own Search
+// (a Search needs about 24 bytes per terrain cell: 20 in dense arrays including the heap
+// position index, plus open list entries; bidirectional queries add 16, jump point tables 9)
+class QueryEngine {
+public:
+    // 0 threads means one per hardware thread
+    explicit QueryEngine(const Terrain& terrain, uint threads = 0) : pool(threads) {
+        for (uint w = 0; w < pool.size(); ++w)
+            searches.push_back(std::make_unique<Search>(terrain));
+    }
+
+    uint getThreads() const { return pool.size(); }
+
+    void setMode(SearchMode mode) {
+        for (auto& s : searches)
+            s->setMode(mode);
+    }
+
+    // landmark tables shared by all workers, null turns them off
+    void setLandmarks(const Landmarks* landmarks) {
+        for (auto& s : searches)
+            s->setLandmarks(landmarks);
+    }
+
+    // limit of every single query, see SearchBudget
+    // does not apply to hierarchical queries
+    void setBudget(const SearchBudget& b) { budget = b; }
+
+    // results are in the same order as the queries
+    std::vector<QueryResult> run(const std::vector<Query>& queries) {
+        std::vector<QueryResult> results(queries.size());
+
+        pool.run(queries.size(), [&](uint worker, size_t i) {
+            Search& search = *searches[worker];
+            QueryResult& r = results[i];
+
+            search.setup(queries[i].start, queries[i].end);
+            const SearchProgress progress = search.advance(budget);
+            if (progress == SearchProgress::Found) {
+                r.cost = search.getDistance(queries[i].end);
+                r.length = search.getPathLength();
+            }
+            r.complete = progress != SearchProgress::Running;
+            r.expansions = search.getExpansions();
+        });
+
+        return results;
+    }
+
+    // answers the queries on the abstract graph of an up to date hierarchy
+    // costs are approximate, see Hierarchy
+    std::vector<QueryResult> run(const std::vector<Query>& queries, const Hierarchy& hierarchy) {
+        std::vector<QueryResult> results(queries.size());
+
+        std::vector<std::unique_ptr<HierarchicalSearch>> hierarchical;
+        for (uint w = 0; w < pool.size(); ++w)
+            hierarchical.push_back(std::make_unique<HierarchicalSearch>(hierarchy));
+
+        pool.run(queries.size(), [&](uint worker, size_t i) {
+            HierarchicalSearch& search = *hierarchical[worker];
+            QueryResult& r = results[i];
+
+            if (search.run(queries[i].start, queries[i].end)) {
+                r.cost = search.getCost();
+                r.length = uint(search.getPath().size() - 1);
+            }
+            r.expansions = search.getExpansions();
+        });
+
+        return results;
+    }
+
+private:
+    ThreadPool pool;
+    std::vector<std::unique_ptr<Search>> searches;  // one per worker
+    SearchBudget budget;                              // unlimited by default
+};
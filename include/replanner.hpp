@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "budget.hpp"
+#include "change_log.hpp"
+#include "cost.hpp"
+#include "edge_costs.hpp"
+#include "neighborhood.hpp"
+#include "open_list.hpp"
+#include "terrain.hpp"
+
+// D* Lite, an incremental planner that keeps its search tree between plans
+//
+// The search runs from goal toward start. g(c) is the known distance from c to goal and rhs(c)
+// the best one-step lookahead over the neighbors of c; cells where both differ are queued.
+// When the start moves the queue is kept and km grows by the distance moved instead of
+// rekeying it. When heights change only the lookahead of the changed cells and their neighbors
+// is recomputed, and only cells whose distance really changes are expanded again.
+// The heuristic ignores heights, so edits never make a queued key too large.
+class Replanner {
+public:
+    explicit Replanner(const Terrain& terrain) : terrain(terrain), edges(terrain) {
+        g.assign(terrain.size(), infiniteCost);
+        rhs.assign(terrain.size(), infiniteCost);
+        stamps.assign(terrain.size(), 0);
+        heap.resize(terrain.size());
+    }
+
+    // forgets all work and plans from start to goal
+    void reset(Cell from, Cell to) {
+        nextGeneration(generation, 1, stamps);
+        heap.clear();
+        km = 0;
+
+        start = last = from;
+        goal = to;
+        setRhs(goal, 0);
+        heap.push(goal, key(goal));
+    }
+
+    // next plan() starts over
+    void invalidate() { goal = noCell; }
+
+    // the agent moved to s, the search tree is kept
+    void moveStart(Cell s) {
+        km += heuristic(last, s);
+        start = last = s;
+    }
+
+    // heights of these cells changed in place, the next plan() repairs the affected part
+    void cellsChanged(const std::vector<Cell>& cells) {
+        if (goal == noCell) return;
+
+        // every edge touching a changed cell has a new cost
+        for (Cell c : cells) {
+            updateRhs(c);
+            forEachNeighbor<8>(terrain, c, [&](Cell n) { updateRhs(n); });
+        }
+    }
+
+    // cells whose isVisited() changes are added to log, null turns it off
+    // reset() makes every cell unvisited without adding them
+    void setChangeLog(ChangeLog* log) { changes = log; }
+
+    // starts counting expansions of a new plan
+    void beginPlan() { expansions = 0; }
+
+    // expands one cell, true when g(start) is exact
+    // start itself is made consistent too, so getCost() can read g(start)
+    bool iterate() {
+        // keys that tie with the start key up to rounding are expanded as well
+        // the slack can only add expansions: each is an ordinary D* Lite step that makes a cell
+        // consistent, so stopping later never gives a worse g(start), only a bit more work
+        const Key startKey = key(start);
+        const Key bound = {sum(startKey.k1, roundingSlack(startKey.k1)), startKey.k2};
+        if (heap.empty() || !(heap.topKey() < bound || getRhs(start) != getG(start)))
+            return true;
+
+        const Cell u = heap.top();
+        const Key kOld = heap.topKey();
+        const Key kNew = key(u);
+        ++expansions;
+
+        if (kOld < kNew) {
+            // key is outdated since the start moved
+            heap.update(u, kNew);
+        } else if (getG(u) > getRhs(u)) {
+            // distance of u dropped, it is final now
+            setG(u, getRhs(u));
+            heap.remove(u);
+
+            forEachNeighborMove<8>(terrain, u, [&](Cell s, uint move) {
+                if (s == goal) return;
+                const Cost d = sum(edges.cost(move, s, u), getG(u));
+                if (d < getRhs(s))
+                    setRhs(s, d);
+                updateVertex(s);
+            });
+        } else {
+            // distance of u rose, every cell that relied on it looks again
+            const Cost gOld = getG(u);
+            setG(u, infiniteCost);
+
+            forEachNeighborMove<8>(terrain, u, [&](Cell s, uint move) {
+                if (getRhs(s) == sum(edges.cost(move, s, u), gOld))
+                    updateRhs(s);
+            });
+            updateRhs(u);
+        }
+
+        return false;
+    }
+
+    // continues the plan started by beginPlan() until it is done or the budget is used up
+    SearchProgress advance(const SearchBudget& budget) {
+        if (!iterateWithin(budget, [&] { return iterate(); }))
+            return SearchProgress::Running;
+        return getG(start) != infiniteCost ? SearchProgress::Found : SearchProgress::Unreachable;
+    }
+
+    // false if start cannot reach goal
+    bool plan() {
+        beginPlan();
+        while (!iterate())
+            ;
+        return getG(start) != infiniteCost;
+    }
+
+    Cell getStart() const { return start; }
+    Cell getGoal() const { return goal; }
+
+    // distance from start to goal
+    float getCost() const { return costToFloat(getG(start)); }
+
+    // cells expanded since beginPlan()
+    uint64_t getExpansions() const { return expansions; }
+
+    // true if the cell has a known distance to goal
+    bool isVisited(Cell c) const { return getG(c) != infiniteCost; }
+
+    // known distance from c to goal, INFINITY if there is none
+    float getDistance(Cell c) const { return costToFloat(getG(c)); }
+
+    // neighbor of c on its shortest path to goal, noCell for goal and cells without a distance
+    Cell getNext(Cell c) const { return c == goal || getG(c) == infiniteCost ? noCell : next(c); }
+
+    // calls f(cell) for every cell on the path from start to goal, both included
+    template <class F>
+    void forEachPathCell(F&& f) const {
+        if (goal == noCell || getG(start) == infiniteCost)
+            return;
+
+        Cell c = start;
+        for (size_t steps = 0; steps < terrain.size(); ++steps) {
+            f(c);
+            if (c == goal)
+                return;
+            c = next(c);
+        }
+    }
+
+    // number of steps from start to goal, 0 if there is no path
+    uint getPathLength() const {
+        uint length = 0;
+        forEachPathCell([&](Cell) { ++length; });
+        return length ? length - 1 : 0;
+    }
+
+private:
+    struct Key {
+        Cost k1 = 0, k2 = 0;
+
+        bool operator<(const Key& o) const { return k1 < o.k1 || (k1 == o.k1 && k2 < o.k2); }
+    };
+
+    const Terrain& terrain;
+    const EdgeCosts edges;  // cost of every move to a neighbor
+
+    // planner state, indexed by cell
+    std::vector<Cost> g;           // distance to goal
+    std::vector<Cost> rhs;         // lookahead distance to goal
+    std::vector<uint32_t> stamps;  // generation that last touched the cell
+    uint32_t generation = 1;       // current plan, older stamps are stale
+
+    OpenListOf<Key> heap;  // inconsistent cells
+
+    Cell start = noCell;
+    Cell last = noCell;  // start when km was last raised
+    Cell goal = noCell;
+    Cost km = 0;         // heuristic distance the start moved so far
+
+    uint64_t expansions = 0;
+
+    ChangeLog* changes = nullptr;  // optional, see setChangeLog()
+
+    Cost getG(Cell c) const { return stamps[c] == generation ? g[c] : infiniteCost; }
+    Cost getRhs(Cell c) const { return stamps[c] == generation ? rhs[c] : infiniteCost; }
+
+    void touch(Cell c) {
+        if (stamps[c] != generation) {
+            stamps[c] = generation;
+            g[c] = rhs[c] = infiniteCost;
+        }
+    }
+
+    void setG(Cell c, Cost value) {
+        touch(c);
+        if (changes && (g[c] == infiniteCost) != (value == infiniteCost))
+            changes->add(c);
+        g[c] = value;
+    }
+
+    void setRhs(Cell c, Cost value) {
+        touch(c);
+        rhs[c] = value;
+    }
+
+    static Cost sum(Cost a, Cost b) { return a == infiniteCost || b == infiniteCost ? infiniteCost : a + b; }
+
+    Key key(Cell c) const {
+        const Cost m = std::min(getG(c), getRhs(c));
+        return {sum(sum(m, heuristic(start, c)), km), m};
+    }
+
+    // queues c while it is inconsistent
+    void updateVertex(Cell c) {
+        if (getG(c) != getRhs(c))
+            heap.update(c, key(c));
+        else
+            heap.remove(c);
+    }
+
+    // recomputes the lookahead of c from its neighbors
+    void updateRhs(Cell c) {
+        if (c != goal) {
+            Cost best = infiniteCost;
+            forEachNeighborMove<8>(terrain, c, [&](Cell n, uint move) { best = std::min(best, sum(edges.cost(move, c, n), getG(n))); });
+            setRhs(c, best);
+        }
+        updateVertex(c);
+    }
+
+    // neighbor of c on the shortest path to goal
+    Cell next(Cell c) const {
+        Cell best = noCell;
+        Cost bestCost = infiniteCost;
+        forEachNeighborMove<8>(terrain, c, [&](Cell n, uint move) {
+            const Cost d = sum(edges.cost(move, c, n), getG(n));
+            if (d < bestCost) {
+                bestCost = d;
+                best = n;
+            }
+        });
+        return best;
+    }
+
+    // planar distance, a lower bound that does not depend on heights
+    Cost heuristic(Cell p1, Cell p2) const {
+        float dx = float(terrain.xOf(p1)) - float(terrain.xOf(p2));
+        float dy = float(terrain.yOf(p1)) - float(terrain.yOf(p2));
+        return boundCost(std::sqrt(dx * dx + dy * dy));
+    }
+};
@@ -0,0 +1,570 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "budget.hpp"
+#include "change_log.hpp"
+#include "cost.hpp"
+#include "edge_costs.hpp"
+#include "landmarks.hpp"
+#include "neighborhood.hpp"
+#include "open_list.hpp"
+#include "terrain.hpp"
+
+enum class SearchMode {
+    AStar,      // expands every reached cell
+    JumpPoint,  // jump point search, skips over cells inside flat plateaus
+    Bidirectional,  // A* from start and from end at once, meets in the middle
+};
+
+// state of a single A* search over a shared, read-only terrain
+// every thread that searches needs its own Search, the terrain is never written
+class Search {
+public:
+    explicit Search(const Terrain& terrain) : terrain(terrain), edges(terrain) {
+        // per cell search state, one dense array per field
+        distances.assign(terrain.size(), infiniteCost);
+        estimates.assign(terrain.size(), 0);
+        prevs.assign(terrain.size(), noCell);
+        stamps.assign(terrain.size(), 0);
+        heap.resize(terrain.size());
+    }
+
+    void clear() {
+        // no cell has to be reset here
+        nextGeneration(generation, 2, stamps, backStamps);
+
+        // clean queue, only touches queued cells
+        heap.clear();
+        expansions = 0;
+
+        backHeap.clear();
+        backExpansions = 0;
+        meeting = noCell;
+        meetingDistance = infiniteCost;
+    }
+
+    // true if there is state of a previous search left
+    bool isDirty() const { return heap.size() || expansions || backHeap.size() || backExpansions; }
+
+    void setup(Cell from, Cell to) {
+        if (isDirty())
+            clear();
+
+        start = from;
+        end = to;
+
+        searchLandmarks = landmarks && !landmarks->isDirty() ? landmarks : nullptr;
+        if (searchLandmarks) {
+            startLandmarks = searchLandmarks->row(start);
+            endLandmarks = searchLandmarks->row(end);
+        }
+
+        if (mode == SearchMode::JumpPoint && flat.empty())
+            buildJumpTables(nullptr);
+
+        stamps[start] = generation;
+        distances[start] = 0;
+        estimates[start] = heuristic(start);
+        prevs[start] = noCell;
+        heap.push(start, estimates[start]);
+
+        if (mode == SearchMode::Bidirectional)
+            setupBackward();
+    }
+
+    // expands one cell, true when the search is done
+    bool iterate() {
+        if (mode == SearchMode::Bidirectional)
+            return iterateBidirectional();
+
+        // nothing left to expand, end is unreachable
+        if (heap.empty())
+            return true;
+
+        // get top element from queue
+        Cell active = heap.top();
+
+        // if the active cell is the end, we're done!
+        if (active == end)
+            return true;
+
+        heap.pop();
+        ++expansions;
+
+        if (mode == SearchMode::JumpPoint) {
+            expandJumpPoints(active);
+        } else {
+            // relax neighbors
+            forEachNeighborMove<connectivity>(terrain, active, [&](Cell p, uint move) {
+                // new distanc to p
+                relax(active, p, distances[active] + edges.cost(move, active, p));  // active is stamped
+            });
+        }
+
+        // cell is done, don't visit it anymore
+        setVisited(active);
+
+        return false;
+    }
+
+    // continues the search set up by setup() until it is done or the budget is used up
+    SearchProgress advance(const SearchBudget& budget) {
+        if (!iterateWithin(budget, [&] { return iterate(); }))
+            return SearchProgress::Running;
+        return getDistance(end) != INFINITY ? SearchProgress::Found : SearchProgress::Unreachable;
+    }
+
+    // runs a whole search, false if to is unreachable
+    bool run(Cell from, Cell to) {
+        setup(from, to);
+        while (!iterate())
+            ;
+
+        return getDistance(end) != INFINITY;
+    }
+
+    Cell getBest() const {
+        // the best path found so far runs through the meeting cell
+        if (meeting != noCell)
+            return meeting;
+        if (heap.size())
+            return heap.top();
+        else
+            return noCell;
+    }
+
+    Cell getStart() const { return start; }
+    Cell getEnd() const { return end; }
+
+    // takes effect with the next setup()
+    void setMode(SearchMode m) { mode = m; }
+    SearchMode getMode() const { return mode; }
+
+    // tightens the heuristic with landmark distances, null turns it off
+    // tables that are not built when setup() is called are left out of that search
+    // cells keep the estimate they were reached with, so a search in progress starts over from
+    // its start when the heuristic changes; while the new tables are not built it goes on with
+    // the heuristic it was set up with
+    void setLandmarks(const Landmarks* l) {
+        if (l == landmarks)
+            return;
+        landmarks = l;
+
+        const bool ready = !l || !l->isDirty();
+        if (isDirty() && ready)
+            setup(start, end);
+    }
+
+    // cells that become visited are added to log, null turns it off
+    // clear() makes every cell unvisited without adding them
+    void setChangeLog(ChangeLog* log) { changes = log; }
+
+    // builds the tables setup() needs for the current mode ahead of it, so the build can be stopped
+    // false if cancel was set before they were done, setup() builds them again then
+    bool prepare(CancelFlag cancel) {
+        if (mode == SearchMode::JumpPoint && flat.empty())
+            return buildJumpTables(cancel);
+        return true;
+    }
+
+    // has to be called after the terrain was changed, drops tables derived from it
+    void terrainChanged() {
+        flat.clear();
+        for (auto& r : runs)
+            r.clear();
+    }
+
+    // number of cells expanded by the current search, both directions together
+    uint64_t getExpansions() const { return expansions + backExpansions; }
+
+    // cells expanded from end by a bidirectional search
+    uint64_t getBackwardExpansions() const { return backExpansions; }
+
+    // calls f(cell) for every cell on the path from c back to start, both included
+    // a jump point search reaches a cell from its prev with diagonal moves first, straight moves
+    // after, the cells in between are stepped through; plain A* prevs are always neighbors
+    // cells a bidirectional search reached from end also get their path on to end
+    template <class F>
+    void forEachPathCell(Cell c, F&& f) const {
+        if (getDistance(c) == INFINITY)
+            return;
+
+        if (backCost(c) != infiniteCost)
+            for (Cell n = nexts[c]; n != noCell; n = nexts[n])
+                f(n);
+
+        for (; c != start; c = prevs[c]) {
+            const Cell p = prevs[c];
+            const int dx = int(terrain.xOf(c)) - int(terrain.xOf(p));
+            const int dy = int(terrain.yOf(c)) - int(terrain.yOf(p));
+            const int sx = (dx > 0) - (dx < 0);
+            const int sy = (dy > 0) - (dy < 0);
+            const int diagonal = std::min(std::abs(dx), std::abs(dy));
+            const int straight = std::max(std::abs(dx), std::abs(dy)) - diagonal;
+
+            // walk back from c, the straight part comes first
+            const int ax = std::abs(dx) > std::abs(dy) ? sx : 0;
+            const int ay = std::abs(dx) > std::abs(dy) ? 0 : sy;
+            uint x = terrain.xOf(c), y = terrain.yOf(c);
+            for (int i = 0; i < straight; ++i, x -= ax, y -= ay)
+                f(terrain.cellAt(x, y));
+            for (int i = 0; i < diagonal; ++i, x -= sx, y -= sy)
+                f(terrain.cellAt(x, y));
+        }
+        f(start);
+    }
+
+    // number of steps from start to end, 0 if there is no path
+    // consecutive cells of a jump point path are joined by straight or diagonal lines
+    uint getPathLength() const {
+        uint length = 0;
+        if (getDistance(end) != INFINITY)
+            for (Cell c = end; c != start; c = prevs[c])
+                length += std::max(absDiff(terrain.xOf(c), terrain.xOf(prevs[c])),
+                                   absDiff(terrain.yOf(c), terrain.yOf(prevs[c])));
+        return length;
+    }
+
+    // search state of a cell, fields of cells not touched by the current search are stale
+    float getDistance(Cell c) const { return costToFloat(cost(c)); }
+    Cell getPrev(Cell c) const { return stamps[c] >= generation ? prevs[c] : noCell; }
+    bool isVisited(Cell c) const {
+        return stamps[c] == generation + 1 || (!backStamps.empty() && backStamps[c] == generation + 1);
+    }
+
+private:
+    static constexpr uint connectivity = 8;  // neighborhood of a cell, 4, 8 or 16
+
+    const Terrain& terrain;
+    const EdgeCosts edges;  // cost of every move to a neighbor
+
+    // search state, indexed by cell
+    std::vector<Cost> distances;   // distance to start
+    std::vector<Cost> estimates;   // heuristic, computed once when the cell is reached
+    std::vector<Cell> prevs;       // previous cell for shortest path
+    std::vector<uint32_t> stamps;  // generation that last touched the cell, generation + 1 when visited
+
+    uint32_t generation = 2;  // current search, always even, stamps below it are stale
+    uint64_t expansions = 0;  // cells expanded by the current search
+
+    Cell start = noCell;  // search from here
+    Cell end = noCell;    // find path from start to end
+
+    OpenListOf<Cost> heap;  // open list of cells keyed by f-score, see open_list.hpp
+
+    SearchMode mode = SearchMode::AStar;
+
+    const Landmarks* landmarks = nullptr;        // optional ALT tables, see landmarks.hpp
+    const Landmarks* searchLandmarks = nullptr;  // tables of the current search, null if none
+    const float* startLandmarks = nullptr;       // their distances of start and end
+    const float* endLandmarks = nullptr;
+
+    ChangeLog* changes = nullptr;  // optional, see setChangeLog()
+
+    // search from end of a bidirectional search, allocated on first use
+    std::vector<Cost> backDistances;   // distance to end
+    std::vector<Cell> nexts;           // next cell on the way to end
+    std::vector<uint32_t> backStamps;  // same generations as stamps
+    OpenListOf<Cost> backHeap;
+    uint64_t backExpansions = 0;
+
+    Cell meeting = noCell;             // cell on the best path found by both searches
+    Cost meetingDistance = infiniteCost;  // length of that path
+
+    // jump point tables, built on the first jump point search (about 9 bytes per cell)
+    static constexpr uint16_t maxRun = UINT16_MAX;
+    std::vector<uint8_t> flat;                 // 1 if the cell is flat
+    std::array<std::vector<uint16_t>, 4> runs;  // flat cells following a cell in +x, -x, +y, -y, saturated
+
+    void setVisited(Cell c) {
+        stamps[c] = generation + 1;
+        if (changes)
+            changes->add(c);
+    }
+
+    static uint absDiff(uint a, uint b) { return a > b ? a - b : b - a; }
+
+    Cost cost(Cell c) const { return stamps[c] >= generation ? distances[c] : infiniteCost; }
+
+    // reach p from active with distance dist
+    void relax(Cell active, Cell p, Cost dist) {
+        if (stamps[p] == generation + 1) return;  // skip visited cells
+
+        // if p is new or the distance is lower
+        const bool reached = stamps[p] == generation;
+        if (!reached || dist < distances[p]) {
+            if (!reached)
+                estimates[p] = heuristic(p);
+
+            stamps[p] = generation;
+            distances[p] = dist;
+            prevs[p] = active;
+
+            // inserts p or decreases its key, f-score is cached in the open list
+            heap.push(p, dist + estimates[p]);
+
+            if (mode == SearchMode::Bidirectional)
+                meet(p);
+        }
+    }
+
+    // Bidirectional A*
+    //
+    // A second search runs from end toward start, the side with the smaller open list is expanded
+    // next. Every cell reached by both sides is a candidate path, the best one is kept.
+    // The forward search uses the balanced heuristic (d(p, end) - d(p, start)) / 2 and the
+    // backward search its negation. Then both are Dijkstra searches on the same graph with
+    // reduced edge costs, and the best candidate is the shortest path as soon as it is no longer
+    // than the sum of the two smallest open list keys.
+
+    Cost backCost(Cell c) const {
+        return !backStamps.empty() && backStamps[c] >= generation ? backDistances[c] : infiniteCost;
+    }
+
+    // heuristic of the search from end, the negated one of the forward search
+    Cost backHeuristic(Cell p) const { return stamps[p] >= generation ? -estimates[p] : -heuristic(p); }
+
+    void setupBackward() {
+        if (backStamps.empty()) {
+            backDistances.assign(terrain.size(), infiniteCost);
+            nexts.assign(terrain.size(), noCell);
+            backStamps.assign(terrain.size(), 0);
+            backHeap.resize(terrain.size());
+        }
+
+        backStamps[end] = generation;
+        backDistances[end] = 0;
+        nexts[end] = noCell;
+        backHeap.push(end, backHeuristic(end));
+        meet(end);
+    }
+
+    bool iterateBidirectional() {
+        // no open cell can lead to a shorter path than the best candidate
+        if (heap.empty() || backHeap.empty() || meetingDistance <= heap.topKey() + backHeap.topKey()) {
+            finishBidirectional();
+            return true;
+        }
+
+        if (heap.size() <= backHeap.size()) {
+            Cell active = heap.top();
+            heap.pop();
+            ++expansions;
+
+            forEachNeighborMove<connectivity>(terrain, active, [&](Cell p, uint move) {
+                relax(active, p, distances[active] + edges.cost(move, active, p));
+            });
+            setVisited(active);
+        } else {
+            Cell active = backHeap.top();
+            backHeap.pop();
+            ++backExpansions;
+
+            forEachNeighborMove<connectivity>(terrain, active, [&](Cell p, uint move) {
+                relaxBackward(active, p, backDistances[active] + edges.cost(move, active, p));
+            });
+            backStamps[active] = generation + 1;
+            if (changes)
+                changes->add(active);
+        }
+
+        return false;
+    }
+
+    // same as relax() for the search from end
+    void relaxBackward(Cell active, Cell p, Cost dist) {
+        if (backStamps[p] == generation + 1) return;
+
+        if (dist < backCost(p)) {
+            backStamps[p] = generation;
+            backDistances[p] = dist;
+            nexts[p] = active;
+
+            backHeap.push(p, dist + backHeuristic(p));
+            meet(p);
+        }
+    }
+
+    // p got a new distance from one side, it may join both to a shorter path
+    void meet(Cell p) {
+        const Cost forward = cost(p), backward = backCost(p);
+        if (forward == infiniteCost || backward == infiniteCost) return;
+
+        const Cost total = forward + backward;
+        if (total < meetingDistance) {
+            meetingDistance = total;
+            meeting = p;
+        }
+    }
+
+    // links the part of the path found from end into prevs, so the result reads like plain A*
+    void finishBidirectional() {
+        if (meeting == noCell)
+            return;
+
+        for (Cell c = meeting; c != end; c = nexts[c]) {
+            const Cell n = nexts[c];
+            if (stamps[n] < generation)
+                stamps[n] = generation;
+            distances[n] = meetingDistance - backDistances[n];
+            prevs[n] = c;
+        }
+
+        // both open lists stay as they are, isDirty() has to see them
+    }
+
+    // Jump point search on banded terrain
+    //
+    // A cell is flat if it and all 8 neighbors have the same height. Around a flat cell every move
+    // costs the same as on an open uniform grid, so the pruning rules of jump point search hold
+    // there and flat cells never have forced neighbors. Only cells that are not flat (next to a
+    // level boundary or the border) and the end become jump points, they are expanded in all 8
+    // directions. Flat cells on a diagonal jump are passed through and their two straight side
+    // rays are followed right away, so a jump point is always reached from its parent by diagonal
+    // moves first and straight moves after. Costs along a jump are exact, so the result is the
+    // same as with plain A*.
+
+    bool isFlat(uint x, uint y) const {
+        if (x == 0 || y == 0 || x + 1 >= terrain.getWidth() || y + 1 >= terrain.getHeight())
+            return false;
+
+        const uint8_t h = terrain.getLevel(terrain.cellAt(x, y));
+        for (uint ny = y - 1; ny <= y + 1; ++ny) {
+            const uint8_t* row = terrain.row(ny);
+            if (row[x - 1] != h || row[x] != h || row[x + 1] != h)
+                return false;
+        }
+        return true;
+    }
+
+    // precomputes straight jumps (JPS+), a side ray becomes a single lookup
+    // false if cancel was set before they were done, no tables are left then
+    bool buildJumpTables(CancelFlag cancel) {
+        const uint w = terrain.getWidth();
+        const uint h = terrain.getHeight();
+
+        flat.assign(terrain.size(), 0);
+        for (uint y = 0; y < h; ++y) {
+            if ((y & 63) == 0 && isCancelled(cancel)) {
+                terrainChanged();
+                return false;
+            }
+            for (uint x = 0; x < w; ++x)
+                flat[terrain.cellAt(x, y)] = isFlat(x, y);
+        }
+
+        if (isCancelled(cancel)) {
+            terrainChanged();
+            return false;
+        }
+        for (auto& r : runs)
+            r.assign(terrain.size(), 0);
+
+        auto extend = [](uint16_t next) { return next == maxRun ? maxRun : uint16_t(next + 1); };
+        for (uint y = 0; y < h; ++y) {
+            for (uint x = w - 1; x-- > 0;) {
+                Cell c = terrain.cellAt(x, y);
+                if (flat[c + 1]) runs[0][c] = extend(runs[0][c + 1]);
+            }
+            for (uint x = 1; x < w; ++x) {
+                Cell c = terrain.cellAt(x, y);
+                if (flat[c - 1]) runs[1][c] = extend(runs[1][c - 1]);
+            }
+        }
+        for (uint y = h - 1; y-- > 0;)
+            for (uint x = 0; x < w; ++x) {
+                Cell c = terrain.cellAt(x, y);
+                if (flat[c + w]) runs[2][c] = extend(runs[2][c + w]);
+            }
+        for (uint y = 1; y < h; ++y)
+            for (uint x = 0; x < w; ++x) {
+                Cell c = terrain.cellAt(x, y);
+                if (flat[c - w]) runs[3][c] = extend(runs[3][c - w]);
+            }
+        return true;
+    }
+
+    void expandJumpPoints(Cell active) {
+        for (const Offset& o : Neighborhood<8>::offsets)
+            jump(active, o.dx, o.dy);
+    }
+
+    // walks from active in direction (dx, dy) until the next jump point and relaxes it
+    void jump(Cell active, int dx, int dy) {
+        uint x = terrain.xOf(active) + dx;
+        uint y = terrain.yOf(active) + dy;
+        if (x >= terrain.getWidth() || y >= terrain.getHeight())
+            return;
+
+        // the first step may change height, every following one stays on the plateau
+        Cell c = terrain.cellAt(x, y);
+        Cost dist = distances[active] + edges.cost(moveClass(dx, dy), active, c);  // active is stamped
+
+        if (c == end || !flat[c]) {
+            relax(active, c, dist);
+            return;
+        }
+
+        if (!dx || !dy) {
+            ray(active, x, y, dx, dy, dist);
+            return;
+        }
+
+        const Cost step = edges.flatCost(moveClass(dx, dy));
+        const int64_t next = int64_t(dy) * terrain.getWidth() + dx;
+
+        // flat cells have all neighbors inside the terrain, so the walk cannot leave it
+        while (c != end && flat[c]) {
+            ray(active, x, y, dx, 0, dist);
+            ray(active, x, y, 0, dy, dist);
+
+            x += dx;
+            y += dy;
+            c = Cell(c + next);
+            dist += step;
+        }
+        relax(active, c, dist);
+    }
+
+    // straight walk from the flat cell (x, y) that was reached with dist
+    // relaxes the first cell on the way that is the end or not flat
+    void ray(Cell active, uint x, uint y, int dx, int dy, Cost dist) {
+        const std::vector<uint16_t>& run = runs[dx > 0 ? 0 : dx < 0 ? 1 : dy > 0 ? 2 : 3];
+
+        // flat cells after (x, y), long runs are saturated and continued
+        uint steps = 0;
+        for (uint r; (r = run[terrain.cellAt(x + dx * int(steps), y + dy * int(steps))]) == maxRun;)
+            steps += r;
+        steps += run[terrain.cellAt(x + dx * int(steps), y + dy * int(steps))] + 1;
+
+        // the end stops the ray early if it lies on it
+        const uint ex = terrain.xOf(end), ey = terrain.yOf(end);
+        if (dx && ey == y && (ex - x) * dx - 1 < steps)
+            steps = (ex - x) * dx;
+        else if (dy && ex == x && (ey - y) * dy - 1 < steps)
+            steps = (ey - y) * dy;
+
+        relax(active, terrain.cellAt(x + dx * int(steps), y + dy * int(steps)), dist + Cost(steps) * edges.flatCost(0));
+    }
+
+    // lower bound of the distance from p to a target with the given landmark distances
+    // euclidean distance, raised by the landmark bound if there are landmarks
+    Cost lowerBound(Cell p, Cell target, const float* targetLandmarks) const {
+        float h = cellDistance(terrain, p, target);
+        if (searchLandmarks)
+            h = std::max(h, searchLandmarks->bound(p, targetLandmarks));
+        return boundCost(h);
+    }
+
+    // estimated distance from p to end, balanced between both ends for a bidirectional search
+    Cost heuristic(Cell p) const {
+        if (mode == SearchMode::Bidirectional)
+            return halveCost(lowerBound(p, end, endLandmarks) - lowerBound(p, start, startLandmarks));
+        return lowerBound(p, end, endLandmarks);
+    }
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "model.hpp"
+#include "palette.hpp"
+#include "png_writer.hpp"
+#include "thread_pool.hpp"
+
+// renders the map and the current search into a pyramid of png tiles, no window needed
+//
+// Level 0 has one pixel per cell, every further level halves both sides until the whole map
+// fits into one tile. Tiles go to dir/level/x_y.png. A tile is the 2x2 average of the four
+// tiles of the level below, so the pyramid is rendered depth first and only a few tiles per
+// level are in memory at once, never the whole map. Subtrees are rendered in parallel.
+// Start, end and path win over averaging, so they stay visible in the overviews.
+class Snapshot {
+public:
+    // tiles are tileSize x tileSize pixels, tileSize is rounded up to an even number
+    Snapshot(Model& model, ThreadPool& pool, uint tileSize = 256)
+        : model(model), terrain(model.getTerrain()), pool(pool), tileSize(std::max(2u, (tileSize + 1) & ~1u)) {
+        levels = 1;
+        while (tilesX(levels - 1) > 1 || tilesY(levels - 1) > 1)
+            ++levels;
+    }
+
+    uint getLevels() const { return levels; }
+
+    // false if a directory or file could not be written
+    bool write(const std::string& dir) {
+        std::error_code error;
+        for (uint level = 0; level < levels; ++level) {
+            std::filesystem::create_directories(dir + "/" + std::to_string(level), error);
+            if (error)
+                return false;
+        }
+        this->dir = dir;
+        ok = true;
+
+        collectPath();
+
+        // the lowest level with enough subtrees to keep every worker busy
+        uint split = levels - 1;
+        while (split > 0 && tileCount(split) < 4 * pool.size())
+            --split;
+
+        stored.clear();
+        stored.resize(tileCount(split));
+        splitLevel = levels;  // nothing stored while the subtrees are rendered
+        pool.run(stored.size(), [&](uint, size_t i) { stored[i] = render(split, uint(i % tilesX(split)), uint(i / tilesX(split))); });
+
+        // the levels above are small, they are built from the stored tiles
+        splitLevel = split;
+        if (split + 1 < levels)
+            render(levels - 1, 0, 0);
+
+        stored.clear();
+        path.clear();
+        return ok;
+    }
+
+private:
+    enum Mark : uint8_t { None, Path, End, Start };  // higher marks win when tiles are averaged
+
+    struct Tile {
+        uint width = 0, height = 0;
+        std::vector<Rgb> pixels;     // row-major
+        std::vector<uint8_t> marks;  // Mark of every pixel
+    };
+
+    Model& model;
+    const Terrain& terrain;
+    ThreadPool& pool;
+    const uint tileSize;
+    uint levels;
+
+    std::string dir;
+    std::atomic<bool> ok{true};
+
+    std::vector<Cell> path;  // cells of the best path, sorted
+
+    std::vector<Tile> stored;  // tiles of splitLevel, rendered in parallel
+    uint splitLevel = 0;
+
+    // size of a level in pixels
+    uint levelWidth(uint level) const { return ((terrain.getWidth() - 1) >> level) + 1; }
+    uint levelHeight(uint level) const { return ((terrain.getHeight() - 1) >> level) + 1; }
+
+    uint tilesX(uint level) const { return (levelWidth(level) + tileSize - 1) / tileSize; }
+    uint tilesY(uint level) const { return (levelHeight(level) + tileSize - 1) / tileSize; }
+    size_t tileCount(uint level) const { return size_t(tilesX(level)) * tilesY(level); }
+
+    void collectPath() {
+        path.clear();
+        const Cell best = model.getBest();
+        if (best != noCell)
+            model.forEachPathCell(best, [&](Cell c) { path.push_back(c); });
+        std::sort(path.begin(), path.end());
+    }
+
+    // renders the tile and everything below it, writes them all and returns the tile
+    Tile render(uint level, uint tx, uint ty) {
+        if (level == splitLevel)
+            return std::move(stored[size_t(ty) * tilesX(level) + tx]);
+
+        Tile tile;
+        tile.width = std::min(tileSize, levelWidth(level) - tx * tileSize);
+        tile.height = std::min(tileSize, levelHeight(level) - ty * tileSize);
+        tile.pixels.resize(size_t(tile.width) * tile.height);
+        tile.marks.resize(size_t(tile.width) * tile.height);
+
+        if (level == 0)
+            fillCells(tile, tx * tileSize, ty * tileSize);
+        else
+            fillAverage(tile, level, tx, ty);
+
+        // write the tile
+        PngWriter png(dir + "/" + std::to_string(level) + "/" + std::to_string(tx) + "_" + std::to_string(ty) + ".png",
+                      tile.width, tile.height);
+        for (uint y = 0; y < tile.height; ++y)
+            png.writeRow(&tile.pixels[size_t(y) * tile.width].r);
+        if (!png.finish())
+            ok = false;
+
+        return tile;
+    }
+
+    // one pixel per cell, starting at cell (x0, y0)
+    void fillCells(Tile& tile, uint x0, uint y0) const {
+        const Cell start = model.getStart();
+        const Cell end = model.getEnd();
+
+        for (uint y = 0; y < tile.height; ++y) {
+            const Cell first = terrain.cellAt(x0, y0 + y);
+            auto onPath = std::lower_bound(path.begin(), path.end(), first);
+
+            for (uint x = 0; x < tile.width; ++x) {
+                const Cell cell = first + x;
+                const size_t i = size_t(y) * tile.width + x;
+
+                while (onPath != path.end() && *onPath < cell)
+                    ++onPath;
+
+                if (cell == start) {
+                    tile.pixels[i] = startColor;
+                    tile.marks[i] = Start;
+                } else if (cell == end) {
+                    tile.pixels[i] = endColor;
+                    tile.marks[i] = End;
+                } else if (onPath != path.end() && *onPath == cell) {
+                    tile.pixels[i] = pathColor(terrain.getElevation(cell));
+                    tile.marks[i] = Path;
+                } else {
+                    tile.pixels[i] = terrainColor(terrain.getElevation(cell), model.isVisited(cell));
+                    tile.marks[i] = None;
+                }
+            }
+        }
+    }
+
+    // every pixel from the up to 2x2 pixels it covers on the level below
+    void fillAverage(Tile& tile, uint level, uint tx, uint ty) {
+        // children stay in memory until this tile is done
+        Tile children[2][2];
+        for (uint j = 0; j < 2; ++j)
+            for (uint i = 0; i < 2; ++i)
+                if ((2 * tx + i) < tilesX(level - 1) && (2 * ty + j) < tilesY(level - 1))
+                    children[j][i] = render(level - 1, 2 * tx + i, 2 * ty + j);
+
+        for (uint y = 0; y < tile.height; ++y) {
+            for (uint x = 0; x < tile.width; ++x) {
+                // the 2x2 block always lies in one child since tiles have an even size
+                const uint cx = 2 * x, cy = 2 * y;
+                const Tile& child = children[cy / tileSize][cx / tileSize];
+                const uint lx = cx % tileSize, ly = cy % tileSize;
+
+                uint r = 0, g = 0, b = 0, n = 0;
+                uint8_t mark = None;
+                Rgb marked = {};
+                for (uint sy = ly; sy < std::min(ly + 2, child.height); ++sy)
+                    for (uint sx = lx; sx < std::min(lx + 2, child.width); ++sx) {
+                        const size_t s = size_t(sy) * child.width + sx;
+                        const Rgb& c = child.pixels[s];
+                        r += c.r;
+                        g += c.g;
+                        b += c.b;
+                        ++n;
+                        if (child.marks[s] > mark) {
+                            mark = child.marks[s];
+                            marked = c;
+                        }
+                    }
+
+                const size_t i = size_t(y) * tile.width + x;
+                tile.pixels[i] = mark != None ? marked : Rgb{uint8_t(r / n), uint8_t(g / n), uint8_t(b / n)};
+                tile.marks[i] = mark;
+            }
+        }
+    }
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+typedef unsigned int uint;
+
+// cells are addressed by a 32-bit id: y * width + x
+typedef uint32_t Cell;
+constexpr Cell noCell = UINT32_MAX;
+
+// height of a level, levels are spread evenly over [0, 1]
+inline float levelHeight(uint level, uint levels) {
+    return float(level) / float(levels - 1);
+}
+
+// contiguous, row-major height field
+// holds only the static part of the map, search state lives elsewhere
+//
+// Heights only take a few distinct values, so every cell stores the index of its level in one
+// byte and getElevation() looks the height up in a table. A 4 times smaller field keeps much
+// larger maps in cache than floats would.
+class Terrain {
+public:
+    // levels distinct heights, at most 256
+    Terrain(uint width, uint height, uint levels = 256) : Terrain(width, height, levels, nullptr, nullptr) {}
+
+    // uses level indices that live elsewhere, for example in a mapped file, owner keeps them alive
+    Terrain(uint width, uint height, uint levels, uint8_t* cells, std::shared_ptr<void> owner)
+        : width(width),
+          height(height),
+          levels(levels),
+          owner(std::move(owner)) {
+        if (uint64_t(width) * height >= noCell)
+            throw std::length_error("terrain too large for 32-bit cell ids");
+        if (levels < 2 || levels > 256)
+            throw std::invalid_argument("terrain needs 2 to 256 levels");
+
+        // indices past the last level count as the last level
+        for (uint i = 0; i < heights.size(); ++i)
+            heights[i] = levelHeight(std::min(i, levels - 1), levels);
+
+        if (!cells) {
+            owned.assign(size_t(width) * height, 0);
+            cells = owned.data();
+        }
+        this->cells = cells;
+    }
+
+    // cells may point into owned
+    Terrain(const Terrain&) = delete;
+    Terrain& operator=(const Terrain&) = delete;
+
+    uint getWidth() const { return width; }
+    uint getHeight() const { return height; }
+    uint32_t size() const { return width * height; }
+    uint getLevels() const { return levels; }
+
+    Cell cellAt(uint x, uint y) const { return y * width + x; }
+    uint xOf(Cell c) const { return c % width; }
+    uint yOf(Cell c) const { return c / width; }
+
+    float getElevation(Cell c) const { return heights[cells[c]]; }
+    uint8_t getLevel(Cell c) const { return cells[c]; }
+    void setLevel(Cell c, uint8_t level) { cells[c] = level; }
+
+    // rounds to the nearest level
+    void setElevation(Cell c, float value) { cells[c] = nearestLevel(value); }
+
+    uint8_t nearestLevel(float value) const {
+        return uint8_t(std::clamp(int(value * float(levels - 1) + 0.5f), 0, int(levels) - 1));
+    }
+
+    // level indices of a row
+    uint8_t* row(uint y) { return &cells[size_t(y) * width]; }
+    const uint8_t* row(uint y) const { return &cells[size_t(y) * width]; }
+
+private:
+    const uint width, height;
+    const uint levels;
+    std::array<float, 256> heights;  // height of every level index
+
+    uint8_t* cells;               // level of every cell, in owned or external memory
+    std::vector<uint8_t> owned;   // empty if the levels live elsewhere
+    std::shared_ptr<void> owner;  // keeps external levels alive
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "generator.hpp"
+#include "terrain.hpp"
+
+// binary map file
+//
+// A 64 byte TerrainFileHeader followed by one level index per cell, row-major, starting at
+// dataOffset. The height of a cell is index / (levels - 1), the values quantizeHeight() makes.
+// Numbers are stored in the byte order of the machine, every platform this runs on is little
+// endian. The level indices are in Terrain layout, a mapped file is used as the height field
+// as it is, nothing is read or converted when a map is loaded.
+constexpr char terrainFileMagic[4] = {'P', 'T', 'R', 'N'};
+constexpr uint32_t terrainFileVersion = 1;
+
+struct TerrainFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t levels;         // number of distinct heights, at most 256
+    uint32_t seed;           // of the noise the map was generated from
+    uint32_t octaves;        // generator settings the map was made with
+    uint32_t normalization;  // Normalization
+    double persistence;
+    double stepSize;
+    uint64_t dataOffset;  // first level index, from the start of the file
+    uint8_t reserved[8];
+};
+
+static_assert(sizeof(TerrainFileHeader) == 64, "header layout is part of the file format");
+
+// writes terrain with the settings it was generated from, throws std::runtime_error on failure
+// the file is written next to path and renamed into place, so path is replaced in one step and
+// never truncated while it may still be mapped as the terrain that is being saved
+inline void saveTerrainFile(const std::string& path, const Terrain& terrain, const GeneratorSettings& settings, uint32_t seed) {
+    TerrainFileHeader header = {};
+    std::memcpy(header.magic, terrainFileMagic, sizeof(header.magic));
+    header.version = terrainFileVersion;
+    header.width = terrain.getWidth();
+    header.height = terrain.getHeight();
+    header.levels = terrain.getLevels();
+    header.seed = seed;
+    header.octaves = settings.octaves;
+    header.normalization = uint32_t(settings.normalization);
+    header.persistence = settings.persistence;
+    header.stepSize = settings.stepSize;
+    header.dataOffset = sizeof(TerrainFileHeader);
+
+    const std::string temporary = path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file)
+        throw std::runtime_error("cannot create " + temporary);
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+    // terrain rows are already in file layout
+    for (uint y = 0; ok && y < terrain.getHeight(); ++y)
+        ok = std::fwrite(terrain.row(y), 1, terrain.getWidth(), file) == terrain.getWidth();
+
+    if (std::fclose(file) != 0 || !ok) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("cannot write " + path);
+    }
+
+    // a mapping of the old file keeps its contents, it just has no name any more
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("cannot replace " + path);
+    }
+}
+
+// a terrain file mapped into memory for as long as this lives
+// the mapping is private, cells may be changed but changes never reach the file
+class MappedTerrainFile {
+public:
+    // throws std::runtime_error if the file cannot be mapped or is no valid terrain file
+    explicit MappedTerrainFile(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("cannot open " + path);
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(TerrainFileHeader)) {
+            ::close(fd);
+            throw std::runtime_error(path + " is no terrain file");
+        }
+
+        size = size_t(info.st_size);
+        data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);  // the mapping keeps the file
+        if (data == MAP_FAILED) {
+            data = nullptr;
+            throw std::runtime_error("cannot map " + path);
+        }
+
+        const char* error = validate();
+        if (error) {
+            ::munmap(data, size);
+            data = nullptr;
+            throw std::runtime_error(path + ": " + error);
+        }
+    }
+
+    ~MappedTerrainFile() {
+        if (data)
+            ::munmap(data, size);
+    }
+
+    MappedTerrainFile(const MappedTerrainFile&) = delete;
+    MappedTerrainFile& operator=(const MappedTerrainFile&) = delete;
+
+    const TerrainFileHeader& getHeader() const { return *static_cast<const TerrainFileHeader*>(data); }
+
+    GeneratorSettings getSettings() const {
+        const TerrainFileHeader& h = getHeader();
+        GeneratorSettings settings;
+        settings.octaves = h.octaves;
+        settings.stepSize = h.stepSize;
+        settings.persistence = h.persistence;
+        settings.levels = h.levels;
+        settings.normalization = Normalization(h.normalization);
+        return settings;
+    }
+
+    // level indices of all cells, row-major
+    uint8_t* getCells() { return static_cast<uint8_t*>(data) + getHeader().dataOffset; }
+
+private:
+    void* data = nullptr;
+    size_t size = 0;
+
+    // null if the mapped file can be used, the problem otherwise
+    const char* validate() const {
+        const TerrainFileHeader& h = getHeader();
+        if (std::memcmp(h.magic, terrainFileMagic, sizeof(h.magic)) != 0)
+            return "not a terrain file";
+        if (h.version != terrainFileVersion)
+            return "unsupported terrain file version";
+        if (h.width == 0 || h.height == 0 || uint64_t(h.width) * h.height >= noCell)
+            return "bad dimensions";
+        if (h.levels < 2 || h.levels > 256)
+            return "bad number of levels";
+        if (h.normalization > uint32_t(Normalization::Sampled))
+            return "bad normalization";
+        if (h.dataOffset < sizeof(TerrainFileHeader) || h.dataOffset > size ||
+            size - h.dataOffset < uint64_t(h.width) * h.height)
+            return "file is truncated";
+        return nullptr;
+    }
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef unsigned int uint;
+
+// fixed set of worker threads running index ranges with work stealing
+//
+// run(count, task) splits [0, count) evenly over all workers, each worker
+// takes indices from the front of its own range and, once that is empty,
+// steals the back half of another worker's range
+class ThreadPool {
+public:
+    // 0 threads means one per hardware thread
+    explicit ThreadPool(uint threads = 0) {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        queues = std::make_unique<Queue[]>(threads);
+        count = threads;
+
+        // the calling thread is worker 0
+        for (uint w = 1; w < threads; ++w)
+            workers.emplace_back([this, w] { workerLoop(w); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (auto& t : workers)
+            t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint size() const { return count; }
+
+    // calls task(worker, i) for every i in [0, n), blocks until all are done
+    // worker is in [0, size()) and unique to the calling thread, tasks must not throw
+    // only one run() may be active at a time
+    template <class F>
+    void run(size_t n, F&& task) {
+        if (n == 0) return;
+
+        for (uint w = 0; w < count; ++w) {
+            queues[w].begin = n * w / count;
+            queues[w].end = n * (w + 1) / count;
+        }
+
+        current = [&task](uint w, size_t i) { task(w, i); };
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++round;
+            busy = count - 1;
+        }
+        wake.notify_all();
+
+        work(0);
+
+        // wait for the other workers
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return busy == 0; });
+        current = nullptr;
+    }
+
+private:
+    // range of indices a worker still has to run, padded against false sharing
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        size_t begin = 0, end = 0;
+    };
+
+    uint count;
+    std::unique_ptr<Queue[]> queues;
+    std::vector<std::thread> workers;
+
+    std::function<void(uint, size_t)> current;  // task of the current run()
+
+    std::mutex mutex;
+    std::condition_variable wake;  // a new round started or the pool is stopping
+    std::condition_variable done;  // all workers finished the round
+    uint64_t round = 0;
+    uint busy = 0;  // workers still running in this round
+    bool stopping = false;
+
+    void workerLoop(uint w) {
+        uint64_t seen = 0;
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || round != seen; });
+                if (stopping) return;
+                seen = round;
+            }
+
+            work(w);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0)
+                done.notify_one();
+        }
+    }
+
+    void work(uint w) {
+        size_t i;
+        while (pop(w, i) || steal(w, i))
+            current(w, i);
+    }
+
+    bool pop(uint w, size_t& i) {
+        Queue& q = queues[w];
+        std::lock_guard<std::mutex> lock(q.mutex);
+
+        if (q.begin == q.end) return false;
+        i = q.begin++;
+        return true;
+    }
+
+    bool steal(uint w, size_t& i) {
+        for (uint k = 1; k < count; ++k) {
+            Queue& victim = queues[(w + k) % count];
+            size_t first, last;
+            {
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.begin == victim.end) continue;
+
+                // take the back half, rounded up
+                last = victim.end;
+                first = last - (last - victim.begin + 1) / 2;
+                victim.end = first;
+            }
+
+            // own queue is empty, so only thieves can look at it
+            Queue& own = queues[w];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            own.begin = first + 1;
+            own.end = last;
+            i = first;
+            return true;
+        }
+        return false;
+    }
+};
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "cost.hpp"
+#include "generator.hpp"
+#include "neighborhood.hpp"
+#include "open_list.hpp"
+#include "perlin_noise.hpp"
+
+// position on an unbounded map
+struct TilePoint {
+    int32_t x = 0, y = 0;
+
+    bool operator==(const TilePoint& o) const { return x == o.x && y == o.y; }
+};
+
+// unbounded terrain that is generated in fixed-size tiles on first access
+// only a bounded number of tiles is kept, the least recently used one is dropped
+// when the cache is full and regenerated if it is needed again
+class TiledTerrain {
+public:
+    static constexpr int tileShift = 6;
+    static constexpr int tileSize = 1 << tileShift;  // cells per tile side
+
+    // tiles are generated independently, so MapBounds normalization is replaced by Sampled
+    TiledTerrain(siv::PerlinNoise::seed_type seed, size_t maxTiles, const GeneratorSettings& settings = {})
+        : settings(settings),
+          maxTiles(maxTiles < 1 ? 1 : maxTiles),
+          perlin(seed),
+          bounds(independentBounds(perlin, settings)) {
+        noise.resize(tileSize);
+        for (uint i = 0; i < heights.size(); ++i)
+            heights[i] = levelHeight(std::min(i, settings.levels - 1), settings.levels);
+    }
+
+    float getElevation(int32_t x, int32_t y) {
+        uint64_t key = tileKey(x >> tileShift, y >> tileShift);
+
+        // searches mostly stay inside one tile
+        if (key != lastKey) {
+            lastTile = &fetch(key, x >> tileShift, y >> tileShift);
+            lastKey = key;
+        }
+
+        return heights[(*lastTile)[(y & (tileSize - 1)) * tileSize + (x & (tileSize - 1))]];
+    }
+
+    float getElevation(TilePoint p) { return getElevation(p.x, p.y); }
+
+    // normalization of the raw noise before it is clustered into levels
+    void setNoiseBounds(const NoiseBounds& b) {
+        bounds = b;
+        clear();
+    }
+
+    const NoiseBounds& getNoiseBounds() const { return bounds; }
+
+    void clear() {
+        tiles.clear();
+        index.clear();
+        lastKey = noKey;
+        lastTile = nullptr;
+    }
+
+    const GeneratorSettings& getSettings() const { return settings; }
+
+    size_t getResidentTiles() const { return tiles.size(); }
+    uint64_t getGeneratedTiles() const { return generated; }
+
+private:
+    typedef std::vector<uint8_t> Tile;  // row-major level indices of one tile
+
+    static constexpr uint64_t noKey = UINT64_MAX;
+
+    GeneratorSettings settings;
+    const size_t maxTiles;
+    siv::PerlinNoise perlin;
+    NoiseBounds bounds;  // same for every tile
+    std::array<float, 256> heights;  // height of every level index
+
+    // tiles ordered by last use, front is the most recent
+    std::list<std::pair<uint64_t, Tile>> tiles;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, Tile>>::iterator> index;
+
+    uint64_t lastKey = noKey;  // tile of the previous lookup
+    const Tile* lastTile = nullptr;
+
+    uint64_t generated = 0;     // tiles generated so far, including regenerated ones
+    std::vector<double> noise;  // row buffer
+
+    static uint64_t tileKey(int32_t tx, int32_t ty) {
+        return (uint64_t(uint32_t(ty)) << 32) | uint32_t(tx);
+    }
+
+    Tile& fetch(uint64_t key, int32_t tx, int32_t ty) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            // mark as most recently used
+            tiles.splice(tiles.begin(), tiles, it->second);
+            return it->second->second;
+        }
+
+        // drop the least recently used tile, reuse its memory
+        Tile tile;
+        if (tiles.size() >= maxTiles) {
+            index.erase(tiles.back().first);
+            tile = std::move(tiles.back().second);
+            tiles.pop_back();
+        }
+
+        generate(tile, tx, ty);
+        tiles.emplace_front(key, std::move(tile));
+        index[key] = tiles.begin();
+        return tiles.front().second;
+    }
+
+    void generate(Tile& tile, int32_t tx, int32_t ty) {
+        tile.resize(tileSize * tileSize);
+
+        const double x0 = double(int64_t(tx) * tileSize);
+        for (int r = 0; r < tileSize; ++r) {
+            const double y = double(int64_t(ty) * tileSize + r);
+            generateRow(perlin, settings, bounds, x0, y, &tile[r * tileSize], tileSize, noise.data());
+        }
+
+        ++generated;
+    }
+};
+
+// A* search on a TiledTerrain
+// search state is kept sparse, only cells reached by the search take memory
+class TiledSearch {
+public:
+    explicit TiledSearch(TiledTerrain& terrain) : terrain(terrain) {}
+
+    // runs a whole search, false if to is unreachable
+    bool run(TilePoint from, TilePoint to) {
+        clear();
+        end = to;
+        endElevation = terrain.getElevation(end);
+
+        uint32_t s = node(from);
+        nodes[s].distance = 0;
+        heap.push(s, heuristic(nodes[s]));
+
+        while (!heap.empty()) {
+            uint32_t active = heap.top();
+
+            // if the active cell is the end, we're done!
+            if (nodes[active].pos == end) {
+                goal = active;
+                return true;
+            }
+
+            heap.pop();
+            ++expansions;
+
+            const TilePoint a = nodes[active].pos;
+            const float activeDistance = nodes[active].distance;
+            const float activeElevation = nodes[active].elevation;
+
+            // the map has no border, so every offset is a neighbor
+            for (const Offset& o : Neighborhood<connectivity>::offsets) {
+                uint32_t p = node({a.x + o.dx, a.y + o.dy});
+                Node& n = nodes[p];
+                if (n.visited) continue;  // skip visited cells
+
+                float dist = activeDistance + distance3D(float(o.dx), float(o.dy), activeElevation - n.elevation);
+
+                if (dist < n.distance) {
+                    n.distance = dist;
+                    n.prev = active;
+
+                    // inserts p or decreases its key
+                    heap.push(p, dist + heuristic(n));
+                }
+            }
+
+            // cell is done, don't visit it anymore
+            nodes[active].visited = true;
+        }
+
+        return false;
+    }
+
+    float getCost() const { return goal == none ? INFINITY : nodes[goal].distance; }
+    uint64_t getExpansions() const { return expansions; }
+
+    // cells from end back to start, empty if there is no path
+    std::vector<TilePoint> getPath() const {
+        std::vector<TilePoint> path;
+        for (uint32_t n = goal; n != none; n = nodes[n].prev)
+            path.push_back(nodes[n].pos);
+        return path;
+    }
+
+private:
+    static constexpr uint connectivity = 8;
+    static constexpr uint32_t none = UINT32_MAX;
+
+    struct Node {
+        TilePoint pos;
+        float elevation;
+        float distance = INFINITY;  // distance to start
+        uint32_t prev = none;       // previous node for shortest path
+        bool visited = false;
+    };
+
+    TiledTerrain& terrain;
+
+    std::vector<Node> nodes;                     // every cell reached so far
+    std::unordered_map<uint64_t, uint32_t> ids;  // position to index in nodes
+    OpenList heap;                               // open list of node indices
+
+    TilePoint end;
+    float endElevation = 0.f;
+    uint32_t goal = none;
+    uint64_t expansions = 0;
+
+    void clear() {
+        nodes.clear();
+        ids.clear();
+        heap.clear();
+        goal = none;
+        expansions = 0;
+    }
+
+    // index of the node at p, created on first access
+    uint32_t node(TilePoint p) {
+        uint64_t key = (uint64_t(uint32_t(p.y)) << 32) | uint32_t(p.x);
+        auto [it, inserted] = ids.try_emplace(key, uint32_t(nodes.size()));
+
+        if (inserted) {
+            nodes.push_back({p, terrain.getElevation(p)});
+            heap.grow(uint32_t(nodes.size()));
+        }
+
+        return it->second;
+    }
+
+    // euclidean distance from n to end
+    float heuristic(const Node& n) const {
+        return distance3D(float(int64_t(n.pos.x) - end.x), float(int64_t(n.pos.y) - end.y), n.elevation - endElevation);
+    }
+};
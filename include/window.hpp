@@ -1,27 +1,38 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 
+#include "async_search.hpp"
+#include "height_pyramid.hpp"
 #include "model.hpp"
+#include "palette.hpp"
 
 using std::vector;
 
 class Window {
 public:
-    Window(Model& model, int pixelSize)
+    Window(Model& model, AsyncSearch& pathfinder, int pixelSize)
         : pixelSize(pixelSize),
           model(model),
-          win(sf::VideoMode(model.getWidth() * pixelSize, model.getHeight() * pixelSize), "Path", sf::Style::Titlebar | sf::Style::Close),
-          view(win.getDefaultView()) {
+          pathfinder(pathfinder),
+          win(sf::VideoMode(std::min(model.getWidth() * pixelSize, maxScreenWidth), std::min(model.getHeight() * pixelSize, maxScreenHeight)),
+              "Path", sf::Style::Titlebar | sf::Style::Close),
+          view(win.getDefaultView()),
+          pyramid(model.getTerrain()) {
         // set fps
         win.setFramerateLimit(60);
 
-        // drawing setup
-        img.create(model.getWidth(), model.getHeight());
-        texture.create(model.getWidth(), model.getHeight());
+        // zooming out far enough shows the whole map
+        maxZoom = std::max({7.f, float(model.getWidth() * pixelSize) / float(std::min(model.getWidth() * pixelSize, maxScreenWidth)),
+                            float(model.getHeight() * pixelSize) / float(std::min(model.getHeight() * pixelSize, maxScreenHeight))});
+
         sprite.setTexture(texture);
-        sprite.setScale(pixelSize, pixelSize);
     }
 
     bool isOpen() {
@@ -39,42 +50,39 @@ public:
     void render() {
         win.clear(sf::Color::Black);
 
-        // update pixels on img with model
-        for (int y = 0; y < model.getHeight(); ++y) {
-            for (int x = 0; x < model.getWidth(); ++x) {
-                // get point at (x, y)
-                Model::Point* point = model.getPoint(x, y);
-
-                // set different color for start and end
-                if (point == model.getStart())
-                    img.setPixel(x, y, sf::Color::Green);
-                else if (point == model.getEnd())
-                    img.setPixel(x, y, sf::Color::Red);
-                else {
-                    uint8_t colVal = (uchar)(point->height * 255);
-                    sf::Color col(colVal, colVal, colVal);
-
-                    // draw visited points in a greener shade
-                    if (point->visited)
-                        col.r *= 0.7f;
-
-                    img.setPixel(x, y, col);
+        // the worker pauses while pixels are updated, so they show the search between two slices
+        // while it sets a search up that can take long, the last pixels are shown again
+        if (!pathfinder.isPreparing()) {
+            auto lock = pathfinder.lock();
+            bool redraw = false;
+            if (model.getTerrainVersion() != pyramidVersion) {
+                pyramidVersion = model.getTerrainVersion();
+
+                // edits only repair their blocks, their cells are recolored with the search changes
+                if (model.takeChangedHeights(changed)) {
+                    pyramid.update(changed);
+                } else {
+                    pyramid.build();
+                    redraw = true;
                 }
             }
-        }
 
-        // draw best path
-        Model::Point* p = model.getBest();
-        while (p) {
-            if (p != model.getEnd() && p != model.getStart()) {
-                float factor = p->height;
-                img.setPixel(p->x, p->y, sf::Color(uint8_t(255 * factor), 90, uint8_t(255 * (1.f - factor))));
+            const Region visible = visibleRegion();
+            if (visible != region) {
+                setRegion(visible);
+                redraw = true;
+            }
+
+            if (redraw || model.getVersion() != shownVersion) {
+                shownVersion = model.getVersion();
+                if (!model.takeChangedCells(changed) || redraw)
+                    updatePixels();
+                else
+                    updateCells(changed);
             }
-            p = p->prev;
         }
 
-        // update texture
-        texture.update(img);
+        uploadDirty();
 
         // draw sprite to screen buffer
         win.draw(sprite);
@@ -87,9 +95,199 @@ public:
         win.display();
     }
 
+    // part of the map that is drawn, in blocks of a pyramid level
+    struct Region {
+        uint level = 0;
+        uint x = 0, y = 0;           // first block
+        uint width = 0, height = 0;  // number of blocks
+
+        bool operator!=(const Region& o) const {
+            return level != o.level || x != o.x || y != o.y || width != o.width || height != o.height;
+        }
+    };
+
+    // cells in the view, at the level where one block is about one screen pixel
+    Region visibleRegion() const {
+        const sf::Vector2f center = view.getCenter();
+        const sf::Vector2f size = view.getSize();
+
+        // cells per screen pixel
+        const float density = size.x / float(win.getSize().x) / float(pixelSize);
+
+        Region r;
+        while (r.level + 1 < pyramid.getLevels() && float(2u << r.level) <= density)
+            ++r.level;
+
+        const float left = (center.x - size.x / 2) / pixelSize, right = (center.x + size.x / 2) / pixelSize;
+        const float top = (center.y - size.y / 2) / pixelSize, bottom = (center.y + size.y / 2) / pixelSize;
+
+        // visible cells, at least one
+        const uint x0 = uint(std::clamp(std::floor(left), 0.f, float(model.getWidth() - 1)));
+        const uint x1 = uint(std::clamp(std::ceil(right), float(x0 + 1), float(model.getWidth())));
+        const uint y0 = uint(std::clamp(std::floor(top), 0.f, float(model.getHeight() - 1)));
+        const uint y1 = uint(std::clamp(std::ceil(bottom), float(y0 + 1), float(model.getHeight())));
+
+        r.x = x0 >> r.level;
+        r.y = y0 >> r.level;
+        r.width = ((x1 - 1) >> r.level) + 1 - r.x;
+        r.height = ((y1 - 1) >> r.level) + 1 - r.y;
+        return r;
+    }
+
+    // everything is drawn again for a new region
+    void setRegion(const Region& r) {
+        region = r;
+        pixels.assign(size_t(r.width) * r.height, 0);
+        overlay.resize(pixels.size());
+
+        dirtyTilesX = (r.width + dirtyTileSize - 1) / dirtyTileSize;
+        dirty.assign(size_t(dirtyTilesX) * ((r.height + dirtyTileSize - 1) / dirtyTileSize), DirtyRect{});
+        dirtyTiles.clear();
+
+        // the texture only grows
+        if (r.width > textureWidth || r.height > textureHeight) {
+            textureWidth = std::max(textureWidth, r.width);
+            textureHeight = std::max(textureHeight, r.height);
+            texture.create(textureWidth, textureHeight);
+            sprite.setTexture(texture, true);
+        }
+
+        const int scale = pixelSize << r.level;
+        sprite.setTextureRect(sf::IntRect(0, 0, r.width, r.height));
+        sprite.setPosition(float(r.x * scale), float(r.y * scale));
+        sprite.setScale(scale, scale);
+    }
+
+    // recomputes the color of every block in the region and uploads all of them
+    void updatePixels() {
+        std::fill(overlay.begin(), overlay.end(), 0);
+        markPath();
+
+        for (uint y = 0; y < region.height; ++y) {
+            uint32_t* row = &pixels[size_t(y) * region.width];
+            const uint32_t* over = &overlay[size_t(y) * region.width];
+            for (uint x = 0; x < region.width; ++x)
+                row[x] = over[x] ? over[x] : blockColor(region.level, region.x + x, region.y + y);
+        }
+
+        touched.clear();
+        dirtyAll = true;
+    }
+
+    // recolors the blocks of cells whose search state changed and of the old and new path
+    // the path is walked once per update, the rest of the region is not looked at
+    void updateCells(const vector<Cell>& cells) {
+        touched.clear();
+        for (Cell c : marked) {
+            const int64_t i = blockIndex(c);
+            if (i >= 0) {
+                overlay[i] = 0;
+                touched.push_back(uint32_t(i));
+            }
+        }
+
+        markPath();
+
+        for (Cell c : cells) {
+            const int64_t i = blockIndex(c);
+            if (i >= 0)
+                touched.push_back(uint32_t(i));
+        }
+
+        for (uint32_t i : touched) {
+            const uint x = i % region.width, y = i / region.width;
+            const uint32_t color = overlay[i] ? overlay[i] : blockColor(region.level, region.x + x, region.y + y);
+            if (pixels[i] != color) {
+                pixels[i] = color;
+                markDirty(x, y);
+            }
+        }
+    }
+
+    // index of the block of c in pixels, -1 outside the region
+    int64_t blockIndex(Cell c) const {
+        const uint x = (model.getX(c) >> region.level) - region.x, y = (model.getY(c) >> region.level) - region.y;
+        if (x >= region.width || y >= region.height)  // wraps around for cells left and above
+            return -1;
+        return int64_t(y) * region.width + x;
+    }
+
+    // path, start and end are drawn over the terrain, overlay is 0 where there is nothing
+    // the cells go to marked and their blocks to touched
+    void markPath() {
+        marked.clear();
+        auto mark = [&](Cell c, uint32_t color) {
+            marked.push_back(c);
+            const int64_t i = blockIndex(c);
+            if (i >= 0) {
+                overlay[i] = color;
+                touched.push_back(uint32_t(i));
+            }
+        };
+
+        Cell best = model.getBest();
+        if (best != noCell)
+            model.forEachPathCell(best, [&](Cell p) { mark(p, rgba(pathColor(model.getElevation(p)))); });
+        if (model.getEnd() != noCell)
+            mark(model.getEnd(), rgba(endColor));
+        if (model.getStart() != noCell)
+            mark(model.getStart(), rgba(startColor));
+    }
+
+    // mean height of the block, visited if its center cell is
+    uint32_t blockColor(uint level, uint x, uint y) const {
+        const uint half = (1u << level) / 2;
+        const uint cx = std::min((x << level) + half, model.getWidth() - 1);
+        const uint cy = std::min((y << level) + half, model.getHeight() - 1);
+        return rgba(terrainColor(pyramid.getMean(level, x, y), model.isVisited(model.getCell(cx, cy))));
+    }
+
+    // packs a color in the byte order sf::Texture expects
+    static uint32_t rgba(Rgb color) {
+        const uint8_t bytes[4] = {color.r, color.g, color.b, 255};
+        uint32_t packed;
+        std::memcpy(&packed, bytes, sizeof(packed));
+        return packed;
+    }
+
+    // grows the dirty rectangle of the tile that holds block (x, y) of the region
+    void markDirty(uint x, uint y) {
+        const uint tile = (y / dirtyTileSize) * dirtyTilesX + x / dirtyTileSize;
+        DirtyRect& r = dirty[tile];
+        if (r.x0 >= r.x1)
+            dirtyTiles.push_back(tile);
+        r.x0 = std::min(r.x0, x);
+        r.y0 = std::min(r.y0, y);
+        r.x1 = std::max(r.x1, x + 1);
+        r.y1 = std::max(r.y1, y + 1);
+    }
+
+    // a full redraw goes up in one update, otherwise every dirty rectangle goes up on its own
+    void uploadDirty() {
+        if (dirtyAll) {
+            texture.update(reinterpret_cast<const sf::Uint8*>(pixels.data()), region.width, region.height, 0, 0);
+        } else {
+            for (uint tile : dirtyTiles) {
+                const DirtyRect& r = dirty[tile];
+                const uint w = r.x1 - r.x0, h = r.y1 - r.y0;
+
+                // rows of a rectangle are not contiguous in pixels
+                staging.resize(size_t(w) * h);
+                for (uint y = 0; y < h; ++y)
+                    std::memcpy(&staging[size_t(y) * w], &pixels[size_t(r.y0 + y) * region.width + r.x0], w * sizeof(uint32_t));
+                texture.update(reinterpret_cast<const sf::Uint8*>(staging.data()), w, h, r.x0, r.y0);
+            }
+        }
+
+        for (uint tile : dirtyTiles)
+            dirty[tile] = DirtyRect{};
+        dirtyTiles.clear();
+        dirtyAll = false;
+    }
+
     void displayInfo() {
         auto pt1 = win.mapPixelToCoords({0, 0});
-        auto pt2 = win.mapPixelToCoords({int(model.getWidth()) * pixelSize, int(model.getHeight()) * pixelSize});
+        auto pt2 = win.mapPixelToCoords({int(win.getSize().x), int(win.getSize().y)});
 
         int xLeft = pt1.x / pixelSize;
         int xRight = pt2.x / pixelSize;
@@ -103,20 +301,36 @@ public:
         if (xRight > model.getWidth() - 1) xRight = model.getWidth() - 1;
         if (yLower > model.getHeight() - 1) yLower = model.getHeight() - 1;
 
-        // draw horizontal lines
+        // the grid only has to be built again when the visible range changes
+        const std::array<int, 4> range = {xLeft, xRight, yUpper, yLower};
+        if (range != gridRange) {
+            gridRange = range;
+            buildGrid(xLeft, xRight, yUpper, yLower);
+        }
+
+        win.draw(grid);
+    }
+
+    // lines between the visible cells, all in one vertex array
+    void buildGrid(int xLeft, int xRight, int yUpper, int yLower) {
+        const float top = float(yUpper * pixelSize);
+        const float bottom = float((yLower + 1) * pixelSize);
+        const float left = float(xLeft * pixelSize);
+        const float right = float((xRight + 1) * pixelSize);
+
+        grid.clear();
+        grid.setPrimitiveType(sf::Lines);
+
+        // draw vertical lines
         for (int i = xLeft; i <= xRight; ++i) {
-            sf::Vertex line[] = {
-                sf::Vertex(sf::Vector2f(i * pixelSize, 0), sf::Color::Black),
-                sf::Vertex(sf::Vector2f(i * pixelSize, model.getHeight() * pixelSize), sf::Color::Black)};
-            win.draw(line, 2, sf::Lines);
+            grid.append(sf::Vertex(sf::Vector2f(i * pixelSize, top), sf::Color::Black));
+            grid.append(sf::Vertex(sf::Vector2f(i * pixelSize, bottom), sf::Color::Black));
         }
 
-        // draw vertial lines
+        // draw horizontal lines
         for (int i = yUpper; i <= yLower; ++i) {
-            sf::Vertex line[] = {
-                sf::Vertex(sf::Vector2f(0, i * pixelSize), sf::Color::Black),
-                sf::Vertex(sf::Vector2f(model.getWidth() * pixelSize, i * pixelSize), sf::Color::Black)};
-            win.draw(line, 2, sf::Lines);
+            grid.append(sf::Vertex(sf::Vector2f(left, i * pixelSize), sf::Color::Black));
+            grid.append(sf::Vertex(sf::Vector2f(right, i * pixelSize), sf::Color::Black));
         }
     }
 
@@ -135,7 +349,7 @@ public:
         drawInfo = zoom < 0.1;
 
         if (zoom < 0.01) zoom = 0.01;
-        if (zoom > 7.f) zoom = 7.f;
+        if (zoom > maxZoom) zoom = maxZoom;
 
         view.setSize(win.getDefaultView().getSize());
         view.zoom(zoom);
@@ -147,17 +361,49 @@ public:
     }
 
 private:
+    // the window never gets larger than this, larger maps are panned and zoomed
+    static constexpr uint maxScreenWidth = 1600;
+    static constexpr uint maxScreenHeight = 1000;
+
     const int pixelSize;
 
     float zoom = 1.f;
+    float maxZoom;
 
     Model& model;
+    AsyncSearch& pathfinder;
     sf::RenderWindow win;
     sf::View view;
 
-    sf::Image img;
+    HeightPyramid pyramid;                 // terrain at lower detail for zoomed out views
+    uint64_t pyramidVersion = UINT64_MAX;  // terrain version the pyramid was built for
+
+    // what the texture shows, one RGBA color per block of the region
+    Region region;
+    vector<uint32_t> pixels;
+    vector<uint32_t> overlay;            // path, start and end colors of the last update
+    vector<Cell> marked;                 // cells drawn in overlay
+    vector<Cell> changed;                // taken from the model, kept to reuse its memory
+    vector<uint32_t> touched;            // blocks to recolor in updateCells()
+    uint64_t shownVersion = UINT64_MAX;  // model version pixels were computed for
+
+    // pixels not uploaded yet, the region is split into tiles with one dirty rectangle each
+    struct DirtyRect {
+        uint x0 = UINT32_MAX, y0 = UINT32_MAX, x1 = 0, y1 = 0;  // empty if x0 >= x1
+    };
+    static constexpr uint dirtyTileSize = 64;
+    uint dirtyTilesX = 0;
+    vector<DirtyRect> dirty;   // by tile
+    vector<uint> dirtyTiles;   // tiles with a nonempty rectangle
+    bool dirtyAll = false;     // all of pixels
+    vector<uint32_t> staging;  // one rectangle, packed for the upload
+
     sf::Texture texture;
+    uint textureWidth = 0, textureHeight = 0;
     sf::Sprite sprite;
 
+    sf::VertexArray grid;                             // grid lines of the visible cells
+    std::array<int, 4> gridRange = {-1, -1, -1, -1};  // cells the grid was built for, left right upper lower
+
     bool drawInfo = false;
 };
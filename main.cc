@@ -1,5 +1,6 @@
 #include <cstdlib>
 
+#include "async_search.hpp"
 #include "controller.hpp"
 #include "model.hpp"
 #include "window.hpp"
@@ -8,8 +9,9 @@ int main() {
     srand(time(NULL));
 
     Model model(4 * 50, 3 * 50);
-    Window window(model, 6);
-    Controller controller(window, model);
+    AsyncSearch pathfinder(model);  // searches while the window keeps rendering
+    Window window(model, pathfinder, 6);
+    Controller controller(window, model, pathfinder);
 
     while (window.isOpen()) {
         sf::Event event;
@@ -18,6 +20,7 @@ int main() {
             controller.handleEvent(event);
         }
 
+        controller.update();
         window.render();
     }
 
@@ -0,0 +1,57 @@
+#include <cmath>
+#include <cstdio>
+
+#include "model.hpp"
+
+// turns the landmark heuristic on and off while a search is in progress
+// the search has to finish without touching missing tables and find the same cost as plain A*
+
+static int failures = 0;
+
+static void expect(bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        ++failures;
+    }
+}
+
+static bool sameCost(float a, float b) { return std::abs(a - b) <= 1e-3f * std::max(1.f, a); }
+
+// a few expansions, then landmarks are switched and the search runs to its end
+static float switchMidSearch(Model& model, bool buildFirst, bool on) {
+    model.setupPathfinding();
+    model.advancePathfinding({500, std::chrono::microseconds::max()});
+    if (buildFirst)
+        model.getLandmarks();
+    model.setUseLandmarks(on);
+    while (model.advancePathfinding({}) == SearchProgress::Running)
+        ;
+    return model.getCost();
+}
+
+int main() {
+    for (SearchMode mode : {SearchMode::AStar, SearchMode::Bidirectional}) {
+        Model model(300, 200, 11, {}, 1);
+        model.setSearchMode(mode);
+        model.setStart(model.getCell(3, 4));
+        model.setEnd(model.getCell(290, 180));
+        model.findPath();
+        const float exact = model.getCost();
+        expect(exact != INFINITY, "plain search finds a path");
+
+        // tables not built yet, the search goes on with the euclidean heuristic
+        expect(sameCost(switchMidSearch(model, false, true), exact), "landmarks on, tables not built");
+
+        // tables built now, the search starts over with them
+        model.setUseLandmarks(false);
+        expect(sameCost(switchMidSearch(model, true, true), exact), "landmarks on, tables built");
+
+        // and back off
+        expect(sameCost(switchMidSearch(model, false, false), exact), "landmarks off");
+    }
+
+    if (failures)
+        return 1;
+    printf("landmark switch ok\n");
+    return 0;
+}